@@ -23,12 +23,16 @@ void printfint(int x);
 int argint(int n, int *ip);
 int argaddr(int n, uint64 *ip);
 int argstr(int n, char *buf, int max);
+int fetchaddr(uint64 addr, uint64 *ip);
+int fetchstr(uint64 addr, char *buf, int max);
 
 // proc.c
 void procinit(void);
 int create_process(const char *name, void (*fn)(void *), void *arg);
+int create_helper(const char *name, void (*fn)(void *), void *arg);
 void exit_process(int status);
 int wait_process(int *status);
+int waitpid_process(int pid, int *status);
 void scheduler(void) __attribute__((noreturn));
 uint64 sys_getpid(void);
 uint64 sys_yield(void);
@@ -65,3 +69,13 @@ void fs_force_recovery(void);
 
 // file.c
 void fileinit(void);
+
+// sysfile.c
+struct proc;
+struct file;
+int copy_str_from_user(struct proc *p, uint64 src, char *dst, int max);
+struct file* fdget(struct proc *p, int fd);
+int fd_read(struct proc *p, int fd, uint64 dst, int n);
+int fd_write(struct proc *p, int fd, uint64 src, int n);
+int fd_open(struct proc *p, char *path, int omode);
+int fd_close(struct proc *p, int fd);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "riscv.h"
+
+#define MAXARG  16   // max exec arguments
+#define MAXPATH 128
+#define NSEG    4    // PT_LOAD segments per image
+#define USTACK_PAGES 1
+
+// kind of access that faulted
+#define FAULT_READ  0
+#define FAULT_WRITE 1
+#define FAULT_EXEC  2
+
+struct proc;
+
+int exec(char *path, char **argv);
+int exec_fault(struct proc *p, uint64 va, int kind);
+void exec_release(struct proc *p);
+
+uint64 sys_exec(void);
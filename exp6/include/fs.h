@@ -86,14 +86,18 @@ struct inode {
 enum filetype {
   FD_NONE,
   FD_INODE,
+  FD_PIPE,
 };
 
+struct pipe;
+
 struct file {
   enum filetype type;
   int ref;
   char readable;
   char writable;
   struct inode *ip;
+  struct pipe *pipe;  /* FD_PIPE */
   uint off;
 };
 
@@ -136,8 +140,16 @@ struct file* filedup(struct file *f);
 void fileclose(struct file *f);
 int fileread(struct file *f, char *addr, int n);
 int filewrite(struct file *f, char *addr, int n);
+int fileio(struct file *f, int write, pagetable_t pt, uint64 addr, int n, int off);
 int filestat(struct file *f, struct stat *st);
 
+/* pipe */
+void pipeinit(void);
+int pipealloc(struct file **rf, struct file **wf);
+void pipeclose(struct pipe *pi, int writable);
+int piperead(struct pipe *pi, pagetable_t pt, uint64 addr, int n);
+int pipewrite(struct pipe *pi, pagetable_t pt, uint64 addr, int n);
+
 struct fs_usage_stats {
   uint total_blocks;
   uint data_blocks;
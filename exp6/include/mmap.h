@@ -0,0 +1,25 @@
+#pragma once
+
+#include "riscv.h"
+
+// Mapped files land in a per-process window. Processes without their own
+// page table run on the kernel page table, so every proc slot gets a
+// separate window there; the range sits below KERNBASE, clear of devices.
+#define MMAP_BASE   0x40000000L
+#define MMAP_WINDOW (16L * 1024 * 1024)   // bytes per proc slot
+
+#define NVMA   8     // mappings per process
+#define NMPAGE 64    // file pages shared between mappings
+
+struct proc;
+struct inode;
+
+void mmapinit(void);
+int mmap_fault(struct proc *p, uint64 va, int write);
+void mmap_release(struct proc *p);
+char *mmap_getpage(struct inode *ip, uint pgoff);
+int mmap_putpage(struct inode *ip, uint pgoff, char *pa);
+
+uint64 sys_mmap(void);
+uint64 sys_munmap(void);
+uint64 sys_msync(void);
@@ -4,10 +4,12 @@
 
 struct file;
 struct inode;
+struct ring;
 
 #define NPROC 32
 #define NCPU  1
 #define NOFILE 16
+#define KSTACK_SIZE PGSIZE
 
 enum procstate {
   UNUSED = 0,
@@ -63,9 +65,12 @@ struct proc {
   struct trapframe *trapframe;
   struct context context;
   struct proc *parent;
+  int nowait;                 // skipped by wait(); only waitpid reaps it
   char name[16];
+  struct spinlock fdlock;     // ofile[] slots, shared with the ring poller
   struct file *ofile[NOFILE];
   struct inode *cwd;
+  struct ring *ring;          // submission ring from ring_setup, or 0
 
   struct kthread_info kthread;
 };
@@ -84,8 +89,10 @@ struct cpu *mycpu(void);
 
 struct proc *alloc_process(void);
 int create_process(const char *name, void (*fn)(void *), void *arg);
+int create_helper(const char *name, void (*fn)(void *), void *arg);
 void exit_process(int status) __attribute__((noreturn));
 int wait_process(int *status);
+int waitpid_process(int pid, int *status);
 
 uint64 sys_getpid(void);
 uint64 sys_yield(void);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "riscv.h"
+
+// Shared submission/completion ring, one page mapped into the owning
+// process. The process fills SQEs and bumps sq_tail; the kernel consumes
+// from sq_head and posts CQEs at cq_tail; the process reaps from cq_head.
+// All indices run freely and are masked with RING_MASK.
+
+#define RING_ENTRIES 64
+#define RING_MASK    (RING_ENTRIES - 1)
+
+// where the ring page lands in a process with its own page table
+#define RING_VA (TRAPFRAME - PGSIZE)
+
+// ring_setup flags
+#define RING_SETUP_SQPOLL 0x1   // a kernel thread polls the SQ
+
+// ring_shared.flags, set by the kernel
+#define RING_SQ_NEED_WAKEUP 0x1 // poller went to sleep; ring_enter wakes it
+
+// idle ticks before the poller sleeps
+#define RING_SQPOLL_IDLE 10
+
+enum {
+  RING_OP_NOP = 0,
+  RING_OP_READ,
+  RING_OP_WRITE,
+  RING_OP_OPEN,
+  RING_OP_CLOSE,
+};
+
+struct ring_sqe {
+  uint8 opcode;
+  uint8 pad[3];
+  int fd;
+  uint64 addr;        // buffer, or path for RING_OP_OPEN
+  uint32 len;
+  int omode;          // RING_OP_OPEN
+  uint64 user_data;   // copied into the completion
+};
+
+struct ring_cqe {
+  uint64 user_data;
+  int64_t res;        // same value the matching syscall would return
+};
+
+struct ring_shared {
+  volatile uint32 sq_head;
+  volatile uint32 sq_tail;
+  volatile uint32 cq_head;
+  volatile uint32 cq_tail;
+  volatile uint32 flags;
+  uint32 entries;
+  struct ring_sqe sqes[RING_ENTRIES];
+  struct ring_cqe cqes[RING_ENTRIES];
+};
+
+struct proc;
+
+void ringinit(void);
+uint64 sys_ring_setup(void);
+uint64 sys_ring_enter(void);
+void ring_release(struct proc *p);
@@ -13,6 +13,7 @@
 #define r_sip() ({ uint64_t x; asm volatile("csrr %0, sip" : "=r"(x)); x; })
 #define r_satp() ({ uint64_t x; asm volatile("csrr %0, satp" : "=r"(x)); x; })
 #define r_sie() ({ uint64_t x; asm volatile("csrr %0, sie" : "=r"(x)); x; })
+#define r_tp() ({ uint64_t x; asm volatile("mv %0, tp" : "=r"(x)); x; })
 #define r_time() ({ uint64_t x; asm volatile("csrr %0, time" : "=r"(x)); x; })
 #define r_mcounteren() ({ uint64_t x; asm volatile("csrr %0, mcounteren" : "=r"(x)); x; })
 #define r_menvcfg() ({ uint64_t x; asm volatile("csrr %0, menvcfg" : "=r"(x)); x; })
@@ -22,3 +22,12 @@
 #define SYS_mkdir   20
 #define SYS_close   21
 #define SYS_yield   22
+#define SYS_ring_setup 23
+#define SYS_ring_enter 24
+#define SYS_readv   25
+#define SYS_writev  26
+#define SYS_pread   27
+#define SYS_pwrite  28
+#define SYS_mmap    29
+#define SYS_munmap  30
+#define SYS_msync   31
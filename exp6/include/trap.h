@@ -98,3 +98,5 @@ uint64 get_ticks(void);
 void *ticks_addr(void);
 void handle_syscall(struct trapframe *tf, struct pushregs *regs);
 void handle_exception(struct trapframe *tf, struct pushregs *regs);
+void usertrap(void);
+void usertrapret(void) __attribute__((noreturn));
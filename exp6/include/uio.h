@@ -0,0 +1,10 @@
+#pragma once
+
+#include "riscv.h"
+
+#define UIO_MAXIOV 16   // max vectors per readv/writev
+
+struct iovec {
+  uint64 iov_base;
+  uint64 iov_len;
+};
@@ -7,6 +7,7 @@ extern pagetable_t kernel_pagetable;
 void kvminit(void);
 void kvminithart(void);
 pte_t *walk(pagetable_t pagetable, uint64 va, int alloc);
+int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm);
 int copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len);
 int copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len);
 int copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max);
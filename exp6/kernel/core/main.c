@@ -6,6 +6,8 @@
 #include "proc.h"
 #include "fs.h"
 #include "panic.h"
+#include "ring.h"
+#include "mmap.h"
 
 void main(void) {
   uart_puts("\nHello, OS!\n");
@@ -13,6 +15,9 @@ void main(void) {
   kvminit();
   kvminithart();
   fileinit();
+  pipeinit();
+  ringinit();
+  mmapinit();
   fs_init();
 
   procinit();
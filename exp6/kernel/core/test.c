@@ -9,6 +9,11 @@
 #include "fs.h"
 #include "fcntl.h"
 #include "syscall.h"
+#include "ring.h"
+#include "uio.h"
+#include "elf.h"
+#include "exec.h"
+#include "mmap.h"
 
 #define TEST_ASSERT(cond, msg)                                      \
   do {                                                              \
@@ -68,6 +73,21 @@ static void invoke_syscall(struct pushregs *regs, struct trapframe *tf) {
   handle_syscall(tf, regs);
 }
 
+static uint64 syscall6(int num, uint64 a0, uint64 a1, uint64 a2, uint64 a3,
+                       uint64 a4, uint64 a5) {
+  struct pushregs regs = {0};
+  struct trapframe tf = {0};
+  regs.a0 = a0;
+  regs.a1 = a1;
+  regs.a2 = a2;
+  regs.a3 = a3;
+  regs.a4 = a4;
+  regs.a5 = a5;
+  regs.a7 = num;
+  invoke_syscall(&regs, &tf);
+  return regs.a0;
+}
+
 static void test_basic_syscalls(void) {
   print_test_banner("syscall basic");
   printf("[TEST] basic system calls...\n");
@@ -226,6 +246,377 @@ static void test_syscall_performance(void) {
   printf("[PASS] syscall performance\n");
 }
 
+static void ring_push(struct ring_shared *sh, uint8 op, int fd, uint64 addr, uint32 len,
+                      int omode, uint64 user_data) {
+  struct ring_sqe *sqe = &sh->sqes[sh->sq_tail & RING_MASK];
+  sqe->opcode = op;
+  sqe->fd = fd;
+  sqe->addr = addr;
+  sqe->len = len;
+  sqe->omode = omode;
+  sqe->user_data = user_data;
+  __atomic_store_n(&sh->sq_tail, sh->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static struct ring_cqe ring_pop(struct ring_shared *sh) {
+  struct ring_cqe cqe = sh->cqes[sh->cq_head & RING_MASK];
+  __atomic_store_n(&sh->cq_head, sh->cq_head + 1, __ATOMIC_RELEASE);
+  return cqe;
+}
+
+// open, three writes and a close through one ring, two traps in total
+static void ring_batch_task(void *arg) {
+  (void)arg;
+  char path[] = "/ring_batch";
+  const char *chunk = "ring";
+  char buf[16];
+
+  uint64 addr = syscall6(SYS_ring_setup, 0, 0, 0, 0, 0, 0);
+  TEST_ASSERT(addr != (uint64)-1, "ring_setup failed");
+  struct ring_shared *sh = (struct ring_shared *)addr;
+  TEST_ASSERT(sh->entries == RING_ENTRIES, "ring entries mismatch");
+
+  ring_push(sh, RING_OP_OPEN, 0, (uint64)path, 0, O_CREATE | O_RDWR, 100);
+  TEST_ASSERT(syscall6(SYS_ring_enter, 1, 0, 0, 0, 0, 0) == 1, "ring open not consumed");
+  struct ring_cqe cqe = ring_pop(sh);
+  TEST_ASSERT(cqe.user_data == 100 && cqe.res >= 0, "ring open failed");
+  int fd = (int)cqe.res;
+
+  for(int i = 0; i < 3; i++)
+    ring_push(sh, RING_OP_WRITE, fd, (uint64)chunk, 4, 0, i);
+  ring_push(sh, RING_OP_CLOSE, fd, 0, 0, 0, 3);
+  TEST_ASSERT(syscall6(SYS_ring_enter, 4, 0, 0, 0, 0, 0) == 4, "ring batch not consumed");
+  for(int i = 0; i < 4; i++) {
+    cqe = ring_pop(sh);
+    TEST_ASSERT(cqe.user_data == (uint64)i, "ring completion out of order");
+    TEST_ASSERT(cqe.res == (i < 3 ? 4 : 0), "ring op result mismatch");
+  }
+  TEST_ASSERT(sh->cq_head == sh->cq_tail, "ring spurious completion");
+
+  memset(buf, 0, sizeof(buf));
+  TEST_ASSERT(fs_read_file(path, buf, sizeof(buf)) == 12, "ring write size mismatch");
+  TEST_ASSERT(strncmp(buf, "ringringring", 12) == 0, "ring write content mismatch");
+  TEST_ASSERT(fs_delete_file(path) == 0, "ring file delete failed");
+  printf("[INFO] ring batch: 5 ops in 2 traps\n");
+}
+
+// with a poller the process only traps to wait for completions
+static void ring_sqpoll_task(void *arg) {
+  (void)arg;
+  uint64 addr = syscall6(SYS_ring_setup, RING_SETUP_SQPOLL, 0, 0, 0, 0, 0);
+  TEST_ASSERT(addr != (uint64)-1, "ring_setup(SQPOLL) failed");
+  struct ring_shared *sh = (struct ring_shared *)addr;
+
+  for(int i = 0; i < 8; i++)
+    ring_push(sh, RING_OP_NOP, 0, 0, 0, 0, i);
+  syscall6(SYS_ring_enter, 8, 8, 0, 0, 0, 0);
+  TEST_ASSERT(sh->cq_tail - sh->cq_head == 8, "sqpoll completions missing");
+  for(int i = 0; i < 8; i++) {
+    struct ring_cqe cqe = ring_pop(sh);
+    TEST_ASSERT(cqe.user_data == (uint64)i && cqe.res == 0, "sqpoll completion mismatch");
+  }
+  printf("[INFO] ring sqpoll: 8 nops completed by the poller\n");
+  // the poller is a child, but not one wait() may block on or reap
+  TEST_ASSERT(wait_process(0) == -1, "wait() saw the ring poller");
+  // exit tears down the ring and reaps the poller
+}
+
+static void test_submission_ring(void) {
+  print_test_banner("submission ring");
+  printf("[TEST] batched syscall ring...\n");
+  int status;
+
+  int pid = create_process("ring-batch", ring_batch_task, 0);
+  TEST_ASSERT(pid > 0, "ring task spawn failed");
+  TEST_ASSERT(waitpid_process(pid, &status) == pid && status == 0, "ring task failed");
+
+  pid = create_process("ring-sqpoll", ring_sqpoll_task, 0);
+  TEST_ASSERT(pid > 0, "sqpoll task spawn failed");
+  TEST_ASSERT(waitpid_process(pid, &status) == pid && status == 0, "sqpoll task failed");
+  printf("[PASS] batched syscall ring\n");
+}
+
+static void test_vectored_io(void) {
+  print_test_banner("vectored and positional io");
+  printf("[TEST] readv/writev/pread/pwrite...\n");
+  char path[] = "/vec_io";
+  char a[] = "head-", b[] = "body-", c[] = "tail";
+  char x[5], y[5], z[8];
+  char buf[16];
+
+  int fd = (int)syscall6(SYS_open, (uint64)path, O_CREATE | O_RDWR, 0, 0, 0, 0);
+  TEST_ASSERT(fd >= 0, "open failed");
+
+  struct iovec iov[3] = {
+    {(uint64)a, 5}, {(uint64)b, 5}, {(uint64)c, 4},
+  };
+  TEST_ASSERT((int)syscall6(SYS_writev, fd, (uint64)iov, 3, 0, 0, 0) == 14, "writev size mismatch");
+
+  // positional io leaves the file offset at 14
+  TEST_ASSERT((int)syscall6(SYS_pwrite, fd, (uint64)"BODY", 4, 5, 0, 0) == 4, "pwrite failed");
+  memset(buf, 0, sizeof(buf));
+  TEST_ASSERT((int)syscall6(SYS_pread, fd, (uint64)buf, 4, 5, 0, 0) == 4, "pread failed");
+  TEST_ASSERT(strncmp(buf, "BODY", 4) == 0, "pread content mismatch");
+  TEST_ASSERT((int)syscall6(SYS_pread, fd, (uint64)buf, 4, -1, 0, 0) == -1,
+              "pread accepted negative offset");
+  TEST_ASSERT((int)syscall6(SYS_write, fd, (uint64)"!", 1, 0, 0, 0) == 1, "append write failed");
+  syscall6(SYS_close, fd, 0, 0, 0, 0, 0);
+
+  // scatter the file back, last vector short
+  fd = (int)syscall6(SYS_open, (uint64)path, O_RDONLY, 0, 0, 0, 0);
+  TEST_ASSERT(fd >= 0, "reopen failed");
+  memset(z, 0, sizeof(z));
+  struct iovec riov[3] = {
+    {(uint64)x, 5}, {(uint64)y, 5}, {(uint64)z, sizeof(z)},
+  };
+  TEST_ASSERT((int)syscall6(SYS_readv, fd, (uint64)riov, 3, 0, 0, 0) == 15, "readv size mismatch");
+  TEST_ASSERT(strncmp(x, "head-", 5) == 0 && strncmp(y, "BODY-", 5) == 0 &&
+              strncmp(z, "tail!", 5) == 0, "readv content mismatch");
+  TEST_ASSERT((int)syscall6(SYS_readv, fd, (uint64)riov, UIO_MAXIOV + 1, 0, 0, 0) == -1,
+              "readv accepted too many vectors");
+  syscall6(SYS_close, fd, 0, 0, 0, 0, 0);
+
+  TEST_ASSERT(fs_delete_file(path) == 0, "vec file delete failed");
+  printf("[PASS] readv/writev/pread/pwrite\n");
+}
+
+static char mmap_data[PGSIZE + 100];
+
+static void test_mmap(void) {
+  print_test_banner("mmap");
+  printf("[TEST] mmap/munmap/msync...\n");
+  char path[] = "/mmap_data";
+  char buf[32];
+
+  for(int i = 0; i < (int)sizeof(mmap_data); i++)
+    mmap_data[i] = 'a' + i % 26;
+  TEST_ASSERT(fs_write_file(path, mmap_data, sizeof(mmap_data)) == (int)sizeof(mmap_data),
+              "mmap file write failed");
+  int fd = (int)syscall6(SYS_open, (uint64)path, O_RDWR, 0, 0, 0, 0);
+  TEST_ASSERT(fd >= 0, "mmap open failed");
+
+  // pages fault in on first touch, past EOF reads as zero
+  char *p = (char *)syscall6(SYS_mmap, 0, sizeof(mmap_data), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+  TEST_ASSERT(p != (char *)-1, "mmap shared failed");
+  TEST_ASSERT(p[0] == 'a' && p[PGSIZE + 99] == mmap_data[PGSIZE + 99], "mmap content mismatch");
+  TEST_ASSERT(p[PGSIZE + 100] == 0 && p[2 * PGSIZE - 1] == 0, "mmap tail not zeroed");
+
+  // a read-only private mapping shares the cached page
+  char *q = (char *)syscall6(SYS_mmap, 0, PGSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+  TEST_ASSERT(q != (char *)-1 && q != p, "mmap private failed");
+  p[10] = 'X';
+  TEST_ASSERT(q[10] == 'X', "shared page not shared");
+
+  // msync and munmap write back through the log
+  TEST_ASSERT(syscall6(SYS_msync, (uint64)p, PGSIZE, 0, 0, 0, 0) == 0, "msync failed");
+  memset(buf, 0, sizeof(buf));
+  TEST_ASSERT(fs_read_file(path, buf, sizeof(buf)) > 10 && buf[10] == 'X', "msync not written");
+  p[20] = 'Y';
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)p + PGSIZE, PGSIZE, 0, 0, 0, 0) == 0,
+              "munmap tail failed");
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)p, PGSIZE, 0, 0, 0, 0) == 0, "munmap failed");
+  TEST_ASSERT(fs_read_file(path, buf, sizeof(buf)) > 20 && buf[20] == 'Y', "munmap not written");
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)q, PGSIZE, 0, 0, 0, 0) == 0, "munmap private failed");
+
+  // writable private pages are copies
+  char *r = (char *)syscall6(SYS_mmap, 0, PGSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  TEST_ASSERT(r != (char *)-1 && r[10] == 'X', "mmap private rw failed");
+  r[10] = 'Z';
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)r, PGSIZE, 0, 0, 0, 0) == 0, "munmap private rw failed");
+  TEST_ASSERT(fs_read_file(path, buf, sizeof(buf)) > 10 && buf[10] == 'X', "private write leaked");
+
+  TEST_ASSERT(syscall6(SYS_mmap, 0, PGSIZE, PROT_READ, MAP_SHARED, fd, 100) == (uint64)-1,
+              "mmap accepted unaligned offset");
+  r = (char *)syscall6(SYS_mmap, 0, 3 * PGSIZE, PROT_READ, MAP_SHARED, fd, 0);
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)r + PGSIZE, PGSIZE, 0, 0, 0, 0) == (uint64)-1,
+              "munmap punched a hole");
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)r, 3 * PGSIZE, 0, 0, 0, 0) == 0, "munmap whole failed");
+
+  // cached pages are reserved up front; private copies are not
+  TEST_ASSERT(syscall6(SYS_mmap, 0, (NMPAGE + 1) * PGSIZE, PROT_READ,
+                       MAP_SHARED, fd, 0) == (uint64)-1,
+              "mmap overcommitted the page cache");
+  r = (char *)syscall6(SYS_mmap, 0, (NMPAGE + 1) * PGSIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+  TEST_ASSERT(r != (char *)-1, "mmap private large failed");
+  TEST_ASSERT(syscall6(SYS_munmap, (uint64)r, (NMPAGE + 1) * PGSIZE, 0, 0, 0, 0) == 0,
+              "munmap private large failed");
+
+  syscall6(SYS_close, fd, 0, 0, 0, 0, 0);
+  TEST_ASSERT(fs_delete_file(path) == 0, "mmap file delete failed");
+  printf("[PASS] mmap/munmap/msync\n");
+}
+
+#define PIPE_TEST_BYTES (3 * PGSIZE + 123)
+static char pipe_src[PIPE_TEST_BYTES];
+static char pipe_dst[PIPE_TEST_BYTES + 1];
+
+// writes more than the ring holds in odd-sized pieces, then closes
+static void pipe_writer_task(void *arg) {
+  struct file *f = arg;
+  for(int i = 0; i < PIPE_TEST_BYTES; i += 1000) {
+    int m = MIN(1000, PIPE_TEST_BYTES - i);
+    TEST_ASSERT(filewrite(f, pipe_src + i, m) == m, "pipe write short");
+  }
+  fileclose(f);
+}
+
+static void test_pipe(void) {
+  print_test_banner("pipe");
+  printf("[TEST] pipe...\n");
+  int fds[2];
+  int status;
+
+  for(int i = 0; i < PIPE_TEST_BYTES; i++)
+    pipe_src[i] = (char)(i * 7);
+  TEST_ASSERT(syscall6(SYS_pipe, (uint64)fds, 0, 0, 0, 0, 0) == 0, "pipe failed");
+
+  // the writer gets its own reference; dropping ours lets the reader see EOF
+  struct file *wf = filedup(myproc()->ofile[fds[1]]);
+  syscall6(SYS_close, fds[1], 0, 0, 0, 0, 0);
+  int pid = create_process("pipe-writer", pipe_writer_task, wf);
+  TEST_ASSERT(pid > 0, "pipe writer spawn failed");
+
+  int total = 0, reads = 0;
+  for(;;) {
+    int r = (int)syscall6(SYS_read, fds[0], (uint64)pipe_dst + total,
+                          MIN(2 * PGSIZE, PIPE_TEST_BYTES + 1 - total), 0, 0, 0);
+    TEST_ASSERT(r >= 0, "pipe read failed");
+    if(r == 0)
+      break;
+    total += r;
+    reads++;
+  }
+  TEST_ASSERT(waitpid_process(pid, &status) == pid && status == 0, "pipe writer failed");
+  TEST_ASSERT(total == PIPE_TEST_BYTES, "pipe byte count mismatch");
+  for(int i = 0; i < PIPE_TEST_BYTES; i++)
+    TEST_ASSERT(pipe_src[i] == pipe_dst[i], "pipe content mismatch");
+  TEST_ASSERT((int)syscall6(SYS_pread, fds[0], (uint64)pipe_dst, 1, 0, 0, 0) == -1,
+              "pread on pipe");
+  syscall6(SYS_close, fds[0], 0, 0, 0, 0, 0);
+  printf("[INFO] pipe moved %d bytes in %d reads\n", total, reads);
+
+  // writing with no reader fails instead of blocking
+  TEST_ASSERT(syscall6(SYS_pipe, (uint64)fds, 0, 0, 0, 0, 0) == 0, "pipe failed");
+  syscall6(SYS_close, fds[0], 0, 0, 0, 0, 0);
+  TEST_ASSERT((int)syscall6(SYS_write, fds[1], (uint64)"x", 1, 0, 0, 0) == -1,
+              "write to closed pipe");
+  syscall6(SYS_close, fds[1], 0, 0, 0, 0, 0);
+  printf("[PASS] pipe\n");
+}
+
+// A tiny executable: headers and code in the first file page, loaded at
+// EXEC_TEXT_VA, then 8 bytes of data at EXEC_DATA_VA followed by bss up
+// to 0x5000. The code is "li a7, SYS_exit; ecall", i.e. exit(argc).
+#define EXEC_TEXT_VA 0x1000
+#define EXEC_DATA_VA 0x3100
+#define EXEC_CODE    0xc0
+#define EXEC_DATA    0x100
+#define EXEC_MAGIC   0x1122334455667788ULL
+
+static char exec_image[EXEC_DATA + 8];
+static volatile uint64 exec_text_pa[2];
+static volatile int exec_probe_ready;
+static volatile int exec_probe_release;
+
+static void build_exec_image(void) {
+  struct elfhdr *eh = (struct elfhdr *)exec_image;
+  struct proghdr *ph = (struct proghdr *)(exec_image + sizeof(*eh));
+  uint32 *code = (uint32 *)(exec_image + EXEC_CODE);
+
+  memset(exec_image, 0, sizeof(exec_image));
+  eh->magic = ELF_MAGIC;
+  eh->entry = EXEC_TEXT_VA + EXEC_CODE;
+  eh->phoff = sizeof(*eh);
+  eh->phentsize = sizeof(*ph);
+  eh->phnum = 2;
+  ph[0].type = ELF_PROG_LOAD;
+  ph[0].flags = ELF_PROG_FLAG_READ | ELF_PROG_FLAG_EXEC;
+  ph[0].vaddr = EXEC_TEXT_VA;
+  ph[0].filesz = ph[0].memsz = EXEC_DATA;
+  ph[1].type = ELF_PROG_LOAD;
+  ph[1].flags = ELF_PROG_FLAG_READ | ELF_PROG_FLAG_WRITE;
+  ph[1].off = EXEC_DATA;
+  ph[1].vaddr = EXEC_DATA_VA;
+  ph[1].filesz = 8;
+  ph[1].memsz = 0x5000 - EXEC_DATA_VA;
+  code[0] = 0x00000893 | (SYS_exit << 20);   // addi a7, zero, SYS_exit
+  code[1] = 0x00000073;                      // ecall
+  *(uint64 *)(exec_image + EXEC_DATA) = EXEC_MAGIC;
+}
+
+// execs the image without leaving the kernel and inspects it
+static void exec_probe_task(void *arg) {
+  int idx = (int)(uint64)arg;
+  struct proc *p = myproc();
+  char *argv[] = {"exec_bin", "x", 0};
+  char path[] = "/exec_bin";
+
+  TEST_ASSERT(exec(path, argv) == 2, "exec failed");
+  pagetable_t pt = p->pagetable;
+  TEST_ASSERT(walkaddr(pt, EXEC_TEXT_VA) == 0, "text read in eagerly");
+  TEST_ASSERT(exec_fault(p, EXEC_TEXT_VA + EXEC_CODE, FAULT_EXEC) == 0, "text fault failed");
+  uint64 pa = walkaddr(pt, EXEC_TEXT_VA);
+  TEST_ASSERT(pa && *(uint32 *)(pa + EXEC_CODE + 4) == 0x00000073, "text contents");
+  TEST_ASSERT(exec_fault(p, EXEC_TEXT_VA, FAULT_WRITE) != 0, "text writable");
+
+  // copyin faults data and bss in on demand; the guard page stays unmapped
+  uint64 v = 0;
+  TEST_ASSERT(copyin(pt, (char *)&v, EXEC_DATA_VA, 8) == 0 && v == EXEC_MAGIC, "data contents");
+  v = 1;
+  TEST_ASSERT(copyin(pt, (char *)&v, 0x5000 - 8, 8) == 0 && v == 0, "bss not zero");
+  TEST_ASSERT(copyin(pt, (char *)&v, 0x5000, 8) < 0, "guard page mapped");
+
+  uint64 uarg;
+  char arg1[4];
+  TEST_ASSERT(copyin(pt, (char *)&uarg, p->trapframe->a1 + 8, 8) == 0, "argv unreadable");
+  TEST_ASSERT(copyinstr(pt, arg1, uarg, sizeof(arg1)) == 0 && strncmp(arg1, "x", 2) == 0,
+              "argv[1] mismatch");
+
+  exec_text_pa[idx] = pa;
+  __sync_fetch_and_add(&exec_probe_ready, 1);
+  while(!exec_probe_release)
+    yield();
+}
+
+static void exec_user_task(void *arg) {
+  (void)arg;
+  char *argv[] = {"exec_bin", "a", "b", 0};
+  char path[] = "/exec_bin";
+  syscall6(SYS_exec, (uint64)path, (uint64)argv, 0, 0, 0, 0);
+  exit_process(-1);   // only reached if exec failed
+}
+
+static void test_exec(void) {
+  print_test_banner("exec");
+  printf("[TEST] demand-paged exec...\n");
+  build_exec_image();
+  TEST_ASSERT(fs_write_file("/exec_bin", exec_image, sizeof(exec_image)) == sizeof(exec_image),
+              "write executable failed");
+
+  exec_probe_ready = 0;
+  exec_probe_release = 0;
+  int a = create_process("exec-probe", exec_probe_task, (void *)0);
+  int b = create_process("exec-probe", exec_probe_task, (void *)1);
+  TEST_ASSERT(a > 0 && b > 0, "exec probe spawn failed");
+  while(exec_probe_ready < 2)
+    yield();
+  TEST_ASSERT(exec_text_pa[0] == exec_text_pa[1], "text pages not shared");
+  exec_probe_release = 1;
+  int status;
+  TEST_ASSERT(waitpid_process(a, &status) == a && status == 0, "exec probe failed");
+  TEST_ASSERT(waitpid_process(b, &status) == b && status == 0, "exec probe failed");
+  printf("[PASS] lazy segments, shared text, argv\n");
+
+  printf("[TEST] exec into user mode...\n");
+  int pid = create_process("exec-user", exec_user_task, 0);
+  TEST_ASSERT(pid > 0, "exec user spawn failed");
+  TEST_ASSERT(waitpid_process(pid, &status) == pid && status == 3, "user program did not exit(argc)");
+  TEST_ASSERT(fs_delete_file("/exec_bin") == 0, "delete executable failed");
+  printf("[PASS] user program ran and exited with argc\n");
+}
+
 void test_printf_basic(void) {
   printf("Testing integer: %d\n", 42);
   printf("Testing negative: %d\n", -123);
@@ -668,5 +1059,10 @@ void run_syscall_tests(void *arg) {
   test_parameter_passing();
   test_security();
   test_syscall_performance();
+  test_submission_ring();
+  test_vectored_io();
+  test_mmap();
+  test_pipe();
+  test_exec();
   printf("[SUITE] syscall tests finished\n");
 }
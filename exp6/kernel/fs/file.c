@@ -1,6 +1,7 @@
 #include "fs.h"
 #include "defs.h"
 #include "panic.h"
+#include "vm.h"
 
 struct {
   struct spinlock lock;
@@ -51,55 +52,124 @@ fileclose(struct file *f) {
   f->type = FD_NONE;
   release(&ftable.lock);
 
-  if(ff.type == FD_INODE) {
+  if(ff.type == FD_PIPE) {
+    pipeclose(ff.pipe, ff.writable);
+  } else if(ff.type == FD_INODE) {
     begin_op();
     iput(ff.ip);
     end_op();
   }
 }
 
+static int
+readi_to(struct inode *ip, pagetable_t pt, uint64 dst, uint off, int n) {
+  if(pt == 0)
+    return readi(ip, dst, off, n);
+
+  char buf[BSIZE];
+  int tot = 0;
+  while(tot < n) {
+    int m = MIN(n - tot, BSIZE);
+    int r = readi(ip, (uint64)buf, off + tot, m);
+    if(r <= 0)
+      return tot ? tot : r;
+    if(copyout(pt, dst + tot, buf, r) < 0)
+      return -1;
+    tot += r;
+    if(r != m)
+      break;
+  }
+  return tot;
+}
+
+static int
+writei_from(struct inode *ip, pagetable_t pt, uint64 src, uint off, int n) {
+  if(pt == 0)
+    return writei(ip, src, off, n);
+
+  char buf[BSIZE];
+  int tot = 0;
+  while(tot < n) {
+    int m = MIN(n - tot, BSIZE);
+    if(copyin(pt, buf, src + tot, m) < 0)
+      return tot ? tot : -1;
+    int r = writei(ip, (uint64)buf, off + tot, m);
+    if(r < 0)
+      return tot ? tot : -1;
+    tot += r;
+  }
+  return tot;
+}
+
+// Move n bytes between [addr, addr+n) and the file at off. With a page
+// table, addr is a user address in it and data goes through a block-sized
+// bounce buffer; otherwise addr is a kernel address. off < 0 means the
+// file's own offset, which is then advanced; pread/pwrite pass an
+// explicit offset and leave f->off alone. Writes are split into chunks
+// of at most 3 blocks, each in its own log transaction, so a larger
+// write is not atomic. A bad user address partway through a write
+// returns the bytes already written.
 int
-fileread(struct file *f, char *addr, int n) {
-  if(f->readable == 0)
+fileio(struct file *f, int write, pagetable_t pt, uint64 addr, int n, int off) {
+  if(n < 0)
     return -1;
-  if(f->type == FD_INODE) {
+  if(write ? f->writable == 0 : f->readable == 0)
+    return -1;
+  if(f->type == FD_PIPE) {
+    if(off >= 0)
+      return -1;
+    return write ? pipewrite(f->pipe, pt, addr, n) : piperead(f->pipe, pt, addr, n);
+  }
+  if(f->type != FD_INODE)
+    return -1;
+
+  if(!write) {
     ilock(f->ip);
-    int r = readi(f->ip, (uint64)addr, f->off, n);
-    if(r > 0)
+    int r = readi_to(f->ip, pt, addr, off < 0 ? f->off : (uint)off, n);
+    if(r > 0 && off < 0)
       f->off += r;
     iunlock(f->ip);
     return r;
   }
-  return -1;
-}
 
-int
-filewrite(struct file *f, char *addr, int n) {
-  if(f->writable == 0)
-    return -1;
-  if(f->type == FD_INODE) {
-    int max = MAXOPBLOCKS * BSIZE;
-    int i = 0;
-    while(i < n) {
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-      begin_op();
-      ilock(f->ip);
-      int r = writei(f->ip, (uint64)addr + i, f->off, n1);
-      if(r > 0)
-        f->off += r;
-      iunlock(f->ip);
-      end_op();
-      if(r < 0)
-        break;
-      if(r != n1)
+  // write a few blocks at a time to avoid exceeding the maximum log
+  // transaction size, including i-node, indirect block, allocation
+  // blocks, and 2 blocks of slop for non-aligned writes.
+  int max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * BSIZE;
+  int i = 0;
+  while(i < n) {
+    int n1 = n - i;
+    if(n1 > max)
+      n1 = max;
+    begin_op();
+    ilock(f->ip);
+    int r = writei_from(f->ip, pt, addr + i, off < 0 ? f->off : (uint)off + i, n1);
+    if(r > 0 && off < 0)
+      f->off += r;
+    iunlock(f->ip);
+    end_op();
+    if(r < 0)
+      break;
+    i += r;
+    if(r != n1) {
+      // through a page table this is a bad user address partway in:
+      // the chunk's prefix is committed, so report it as a short write.
+      if(pt == 0)
         panic("short filewrite");
-      i += r;
+      return i;
     }
-    return i == n ? n : -1;
   }
-  return -1;
+  return i == n ? n : -1;
+}
+
+int
+fileread(struct file *f, char *addr, int n) {
+  return fileio(f, 0, 0, (uint64)addr, n, -1);
+}
+
+int
+filewrite(struct file *f, char *addr, int n) {
+  return fileio(f, 1, 0, (uint64)addr, n, -1);
 }
 
 int
@@ -0,0 +1,251 @@
+#include "defs.h"
+#include "fs.h"
+#include "proc.h"
+#include "kalloc.h"
+#include "panic.h"
+#include "string.h"
+#include "vm.h"
+
+#define NPIPE    (NFILE / 2)
+#define PIPESIZE PGSIZE
+#define PIPEMASK (PIPESIZE - 1)
+
+// A pipe is a page-sized single-producer/single-consumer ring. nwrite is
+// only advanced by the writer and nread only by the reader, so the data
+// path needs no lock; pi->lock only covers sleeping, wakeups and the
+// open counts. Concurrent writers (or readers) on dup'd descriptors take
+// turns through the busy flags, so each side has one owner at a time.
+struct pipe {
+  struct spinlock lock;
+  char *buf;            // one page
+  uint nread;           // bytes consumed, runs freely
+  uint nwrite;          // bytes produced, runs freely
+  int readopen;
+  int writeopen;
+  int rwaiting;         // reader is (about to be) asleep on nread
+  int wwaiting;         // writer is (about to be) asleep on nwrite
+  int rbusy;            // a reader owns the consumer side
+  int wbusy;            // a writer owns the producer side
+  int used;
+};
+
+static struct spinlock pipes_lock;
+static struct pipe pipes[NPIPE];
+
+void
+pipeinit(void) {
+  initlock(&pipes_lock, "pipes");
+}
+
+int
+pipealloc(struct file **rf, struct file **wf) {
+  struct pipe *pi = 0;
+  char *buf = 0;
+
+  *rf = *wf = 0;
+  if((buf = kalloc()) == 0)
+    goto bad;
+  acquire(&pipes_lock);
+  for(struct pipe *p = pipes; p < pipes + NPIPE; p++) {
+    if(!p->used) {
+      p->used = 1;
+      pi = p;
+      break;
+    }
+  }
+  release(&pipes_lock);
+  if(pi == 0)
+    goto bad;
+  if((*rf = filealloc()) == 0 || (*wf = filealloc()) == 0)
+    goto bad;
+
+  initlock(&pi->lock, "pipe");
+  pi->buf = buf;
+  pi->nread = pi->nwrite = 0;
+  pi->readopen = pi->writeopen = 1;
+  pi->rwaiting = pi->wwaiting = 0;
+  pi->rbusy = pi->wbusy = 0;
+
+  (*rf)->type = FD_PIPE;
+  (*rf)->readable = 1;
+  (*rf)->writable = 0;
+  (*rf)->pipe = pi;
+  (*wf)->type = FD_PIPE;
+  (*wf)->readable = 0;
+  (*wf)->writable = 1;
+  (*wf)->pipe = pi;
+  return 0;
+
+bad:
+  if(pi) {
+    acquire(&pipes_lock);
+    pi->used = 0;
+    release(&pipes_lock);
+  }
+  if(buf)
+    kfree(buf);
+  if(*rf)
+    fileclose(*rf);
+  if(*wf)
+    fileclose(*wf);
+  *rf = *wf = 0;
+  return -1;
+}
+
+void
+pipeclose(struct pipe *pi, int writable) {
+  acquire(&pi->lock);
+  if(writable) {
+    pi->writeopen = 0;
+    wakeup(&pi->nread);
+  } else {
+    pi->readopen = 0;
+    wakeup(&pi->nwrite);
+  }
+  int done = !pi->readopen && !pi->writeopen;
+  release(&pi->lock);
+
+  if(done) {
+    kfree(pi->buf);
+    acquire(&pipes_lock);
+    pi->used = 0;
+    release(&pipes_lock);
+  }
+}
+
+static int
+pipe_copyin(pagetable_t pt, char *dst, uint64 src, int n) {
+  if(pt == 0) {
+    memmove(dst, (void *)src, n);
+    return 0;
+  }
+  return copyin(pt, dst, src, n);
+}
+
+static int
+pipe_copyout(pagetable_t pt, uint64 dst, char *src, int n) {
+  if(pt == 0) {
+    memmove((void *)dst, src, n);
+    return 0;
+  }
+  return copyout(pt, dst, src, n);
+}
+
+// take one side of the pipe for the duration of a read or write
+static void
+pipe_own(struct pipe *pi, int *busy) {
+  acquire(&pi->lock);
+  while(*busy)
+    sleep(busy, &pi->lock);
+  *busy = 1;
+  release(&pi->lock);
+}
+
+static void
+pipe_disown(struct pipe *pi, int *busy) {
+  acquire(&pi->lock);
+  *busy = 0;
+  wakeup(busy);
+  release(&pi->lock);
+}
+
+// Wake the other side only if it went to sleep; called once per read or
+// write call, so a stream of small transfers does not wake per byte.
+static void
+pipe_kick(struct pipe *pi, int *waiting, void *chan) {
+  if(__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+    acquire(&pi->lock);
+    wakeup(chan);
+    release(&pi->lock);
+  }
+}
+
+int
+pipewrite(struct pipe *pi, pagetable_t pt, uint64 addr, int n) {
+  struct proc *p = myproc();
+  int i = 0;
+
+  pipe_own(pi, &pi->wbusy);
+  while(i < n) {
+    uint w = pi->nwrite;
+    uint space = PIPESIZE - (w - __atomic_load_n(&pi->nread, __ATOMIC_SEQ_CST));
+    if(space == 0) {
+      // full: hand what we have to the reader and wait for room
+      acquire(&pi->lock);
+      __atomic_store_n(&pi->wwaiting, 1, __ATOMIC_SEQ_CST);
+      if(pi->rwaiting)
+        wakeup(&pi->nread);
+      while(PIPESIZE - (w - __atomic_load_n(&pi->nread, __ATOMIC_SEQ_CST)) == 0 &&
+            pi->readopen && !p->killed)
+        sleep(&pi->nwrite, &pi->lock);
+      __atomic_store_n(&pi->wwaiting, 0, __ATOMIC_SEQ_CST);
+      int dead = !pi->readopen || p->killed;
+      release(&pi->lock);
+      if(dead) {
+        i = -1;
+        break;
+      }
+      continue;
+    }
+    if(!pi->readopen) {
+      i = -1;
+      break;
+    }
+    uint m = MIN(space, (uint)(n - i));
+    m = MIN(m, PIPESIZE - (w & PIPEMASK));
+    if(pipe_copyin(pt, pi->buf + (w & PIPEMASK), addr + i, m) < 0) {
+      if(i == 0)
+        i = -1;
+      break;
+    }
+    __atomic_store_n(&pi->nwrite, w + m, __ATOMIC_SEQ_CST);
+    i += m;
+  }
+  pipe_kick(pi, &pi->rwaiting, &pi->nread);
+  pipe_disown(pi, &pi->wbusy);
+  return i;
+}
+
+// Returns what is buffered, up to n bytes; blocks only while the pipe is
+// empty and a writer is still open. 0 means end of file.
+int
+piperead(struct pipe *pi, pagetable_t pt, uint64 addr, int n) {
+  struct proc *p = myproc();
+  int i = 0;
+
+  pipe_own(pi, &pi->rbusy);
+  uint r = pi->nread;
+  if(__atomic_load_n(&pi->nwrite, __ATOMIC_SEQ_CST) == r) {
+    acquire(&pi->lock);
+    __atomic_store_n(&pi->rwaiting, 1, __ATOMIC_SEQ_CST);
+    while(__atomic_load_n(&pi->nwrite, __ATOMIC_SEQ_CST) == r &&
+          pi->writeopen && !p->killed)
+      sleep(&pi->nread, &pi->lock);
+    __atomic_store_n(&pi->rwaiting, 0, __ATOMIC_SEQ_CST);
+    int killed = p->killed;
+    release(&pi->lock);
+    if(killed) {
+      pipe_disown(pi, &pi->rbusy);
+      return -1;
+    }
+  }
+
+  while(i < n) {
+    uint avail = __atomic_load_n(&pi->nwrite, __ATOMIC_SEQ_CST) - r;
+    if(avail == 0)
+      break;
+    uint m = MIN(avail, (uint)(n - i));
+    m = MIN(m, PIPESIZE - (r & PIPEMASK));
+    if(pipe_copyout(pt, addr + i, pi->buf + (r & PIPEMASK), m) < 0) {
+      if(i == 0)
+        i = -1;
+      break;
+    }
+    r += m;
+    i += m;
+  }
+  __atomic_store_n(&pi->nread, r, __ATOMIC_SEQ_CST);
+  pipe_kick(pi, &pi->wwaiting, &pi->nwrite);
+  pipe_disown(pi, &pi->rbusy);
+  return i;
+}
@@ -0,0 +1,247 @@
+#include "defs.h"
+#include "fs.h"
+#include "proc.h"
+#include "ring.h"
+#include "kalloc.h"
+#include "panic.h"
+#include "string.h"
+#include "trap.h"
+#include "vm.h"
+
+// Kernel side of a ring. Only one context ever consumes the SQ: the
+// owner inside ring_enter, or the poller thread when RING_SETUP_SQPOLL.
+struct ring {
+  struct spinlock lock;
+  struct ring_shared *sh;   // kernel address of the shared page
+  struct proc *owner;
+  int sqpoll;
+  int poller_pid;
+  int dying;
+};
+
+static struct spinlock rings_lock;
+static struct ring rings[NPROC];
+
+void
+ringinit(void) {
+  initlock(&rings_lock, "rings");
+}
+
+static struct ring*
+ring_alloc(struct proc *p) {
+  acquire(&rings_lock);
+  for(struct ring *r = rings; r < rings + NPROC; r++) {
+    if(r->owner == 0) {
+      r->owner = p;
+      release(&rings_lock);
+      initlock(&r->lock, "ring");
+      r->sqpoll = 0;
+      r->poller_pid = 0;
+      r->dying = 0;
+      return r;
+    }
+  }
+  release(&rings_lock);
+  return 0;
+}
+
+static void
+ring_free(struct ring *r) {
+  acquire(&rings_lock);
+  r->sh = 0;
+  r->owner = 0;
+  release(&rings_lock);
+}
+
+static int64_t
+ring_exec(struct proc *p, struct ring_sqe *sqe) {
+  char path[128];
+
+  switch(sqe->opcode) {
+    case RING_OP_NOP:
+      return 0;
+    case RING_OP_READ:
+      return fd_read(p, sqe->fd, sqe->addr, (int)sqe->len);
+    case RING_OP_WRITE:
+      return fd_write(p, sqe->fd, sqe->addr, (int)sqe->len);
+    case RING_OP_OPEN:
+      if(copy_str_from_user(p, sqe->addr, path, sizeof(path)) < 0)
+        return -1;
+      return fd_open(p, path, sqe->omode);
+    case RING_OP_CLOSE:
+      return fd_close(p, sqe->fd);
+    default:
+      return -1;
+  }
+}
+
+// Consume up to max SQEs, posting one CQE each. Stops early when the CQ
+// is full so completions are never dropped; the rest stay queued.
+static int
+ring_submit(struct ring *r, int max) {
+  struct ring_shared *sh = r->sh;
+  int done = 0;
+
+  while(done < max) {
+    uint32 head = sh->sq_head;
+    if(head == __atomic_load_n(&sh->sq_tail, __ATOMIC_ACQUIRE))
+      break;
+    uint32 ctail = sh->cq_tail;
+    if(ctail - __atomic_load_n(&sh->cq_head, __ATOMIC_ACQUIRE) >= RING_ENTRIES)
+      break;
+
+    // copy first: the process may reuse the slot once sq_head moves
+    struct ring_sqe sqe = sh->sqes[head & RING_MASK];
+    __atomic_store_n(&sh->sq_head, head + 1, __ATOMIC_RELEASE);
+
+    struct ring_cqe *cqe = &sh->cqes[ctail & RING_MASK];
+    cqe->res = ring_exec(r->owner, &sqe);
+    cqe->user_data = sqe.user_data;
+    __atomic_store_n(&sh->cq_tail, ctail + 1, __ATOMIC_RELEASE);
+    done++;
+  }
+
+  if(done && r->sqpoll) {
+    acquire(&r->lock);
+    wakeup((void *)&sh->cq_tail);
+    release(&r->lock);
+  }
+  return done;
+}
+
+static int
+sq_empty(struct ring_shared *sh) {
+  return sh->sq_head == __atomic_load_n(&sh->sq_tail, __ATOMIC_SEQ_CST);
+}
+
+// SQPOLL thread: drain the SQ while there is work, spin by yielding for
+// a few ticks after it empties, then advertise RING_SQ_NEED_WAKEUP and
+// sleep until ring_enter kicks it.
+static void
+ring_poller(void *arg) {
+  struct ring *r = arg;
+  struct ring_shared *sh = r->sh;
+  uint64 idle_since = get_ticks();
+
+  acquire(&r->lock);
+  while(!r->dying) {
+    release(&r->lock);
+    int n = ring_submit(r, RING_ENTRIES);
+    acquire(&r->lock);
+    if(n > 0) {
+      idle_since = get_ticks();
+      continue;
+    }
+    if(get_ticks() - idle_since < RING_SQPOLL_IDLE) {
+      release(&r->lock);
+      yield();
+      acquire(&r->lock);
+      continue;
+    }
+    // set the flag before the final check; pairs with ring_enter
+    // publishing sq_tail before it reads the flag
+    __atomic_or_fetch(&sh->flags, RING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+    if(sq_empty(sh) && !r->dying)
+      sleep(r, &r->lock);
+    __atomic_and_fetch(&sh->flags, ~RING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+    idle_since = get_ticks();
+  }
+  release(&r->lock);
+}
+
+// ring_setup(flags): returns the address of the shared page, or -1.
+uint64
+sys_ring_setup(void) {
+  int flags;
+  if(argint(0, &flags) < 0)
+    return -1;
+  struct proc *p = myproc();
+  if(p->ring)
+    return -1;
+
+  struct ring *r = ring_alloc(p);
+  if(r == 0)
+    return -1;
+  struct ring_shared *sh = kalloc();
+  if(sh == 0) {
+    ring_free(r);
+    return -1;
+  }
+  memset(sh, 0, PGSIZE);
+  sh->entries = RING_ENTRIES;
+  r->sh = sh;
+
+  uint64 addr = (uint64)sh;
+  if(p->pagetable) {
+    if(mappages(p->pagetable, RING_VA, PGSIZE, (uint64)sh, PTE_R | PTE_W | PTE_U) != 0) {
+      kfree(sh);
+      ring_free(r);
+      return -1;
+    }
+    addr = RING_VA;
+  }
+  p->ring = r;
+
+  if(flags & RING_SETUP_SQPOLL) {
+    r->sqpoll = 1;
+    r->poller_pid = create_helper("ring-sqpoll", ring_poller, r);
+    if(r->poller_pid < 0) {
+      ring_release(p);
+      return -1;
+    }
+  }
+  return addr;
+}
+
+// ring_enter(to_submit, min_complete): consume up to to_submit SQEs and,
+// with a poller, wait until at least min_complete CQEs are pending.
+// Returns the number of SQEs consumed (with a poller: handed over).
+uint64
+sys_ring_enter(void) {
+  int to_submit, min_complete;
+  if(argint(0, &to_submit) < 0 || argint(1, &min_complete) < 0)
+    return -1;
+  struct proc *p = myproc();
+  struct ring *r = p->ring;
+  if(r == 0 || to_submit < 0)
+    return -1;
+  struct ring_shared *sh = r->sh;
+
+  if(!r->sqpoll)
+    return ring_submit(r, to_submit);
+
+  if(__atomic_load_n(&sh->flags, __ATOMIC_SEQ_CST) & RING_SQ_NEED_WAKEUP) {
+    acquire(&r->lock);
+    wakeup(r);
+    release(&r->lock);
+  }
+  if(min_complete > RING_ENTRIES)
+    min_complete = RING_ENTRIES;
+  acquire(&r->lock);
+  while((int)(sh->cq_tail - sh->cq_head) < min_complete && !p->killed)
+    sleep((void *)&sh->cq_tail, &r->lock);
+  release(&r->lock);
+  return to_submit;
+}
+
+// Tear down p's ring: stop the poller, unmap and free the shared page.
+// Called from exit_process before the file table is closed.
+void
+ring_release(struct proc *p) {
+  struct ring *r = p->ring;
+  if(r == 0)
+    return;
+
+  if(r->sqpoll && r->poller_pid > 0) {
+    acquire(&r->lock);
+    r->dying = 1;
+    wakeup(r);
+    release(&r->lock);
+    waitpid_process(r->poller_pid, 0);
+  }
+  if(p->pagetable)
+    uvmunmap(p->pagetable, RING_VA, 1, 0);
+  kfree(r->sh);
+  p->ring = 0;
+  ring_free(r);
+}
@@ -1,21 +1,57 @@
 #include "defs.h"
 #include "fs.h"
 #include "fcntl.h"
+#include "uio.h"
 #include "proc.h"
 #include "vm.h"
 #include "string.h"
 
+// ofile[] slots change under p->fdlock: the ring poller opens, closes
+// and uses files on behalf of the ring's owner.
 static int
 fdalloc(struct proc *p, struct file *f) {
+  acquire(&p->fdlock);
   for(int fd = 0; fd < NOFILE; fd++) {
     if(p->ofile[fd] == 0) {
       p->ofile[fd] = f;
+      release(&p->fdlock);
       return fd;
     }
   }
+  release(&p->fdlock);
   return -1;
 }
 
+// The file open at fd with a reference of its own, or 0. The caller
+// drops it with fileclose, so a concurrent close cannot free it.
+struct file*
+fdget(struct proc *p, int fd) {
+  struct file *f = 0;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->fdlock);
+  if(p->ofile[fd])
+    f = filedup(p->ofile[fd]);
+  release(&p->fdlock);
+  return f;
+}
+
+// Empty the slot at fd and return the file that was there, still
+// holding the slot's reference.
+static struct file*
+fdclear(struct proc *p, int fd) {
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  acquire(&p->fdlock);
+  f = p->ofile[fd];
+  p->ofile[fd] = 0;
+  release(&p->fdlock);
+  return f;
+}
+
 static int
 copy_from_user(struct proc *p, uint64 src, char *dst, int len) {
   if(p->pagetable == 0) {
@@ -40,9 +76,9 @@ sys_dup(void) {
   if(argint(0, &fd) < 0)
     return -1;
   struct proc *p = myproc();
-  if(fd < 0 || fd >= NOFILE || p->ofile[fd] == 0)
+  struct file *f = fdget(p, fd);
+  if(f == 0)
     return -1;
-  struct file *f = filedup(p->ofile[fd]);
   int newfd = fdalloc(p, f);
   if(newfd < 0) {
     fileclose(f);
@@ -51,56 +87,43 @@ sys_dup(void) {
   return newfd;
 }
 
-uint64
-sys_read(void) {
-  int fd, n;
-  uint64 dst;
-  if(argint(0, &fd) < 0 || argaddr(1, &dst) < 0 || argint(2, &n) < 0)
-    return -1;
-  if(n < 0)
-    return -1;
-  struct proc *p = myproc();
-  if(fd < 0 || fd >= NOFILE)
-    return -1;
-  struct file *f = p->ofile[fd];
-  if(f == 0)
+int
+copy_str_from_user(struct proc *p, uint64 src, char *dst, int max) {
+  if(p->pagetable == 0) {
+    char *s = (char *)src;
+    for(int i = 0; i < max; i++) {
+      dst[i] = s[i];
+      if(s[i] == 0)
+        return 0;
+    }
     return -1;
-
-  char buf[BSIZE];
-  int total = 0;
-  while(total < n) {
-    int m = MIN(n - total, (int)sizeof(buf));
-    int r = fileread(f, buf, m);
-    if(r < 0)
-      return total ? total : -1;
-    if(r == 0)
-      break;
-    if(copy_to_user(p, dst + total, buf, r) < 0)
-      return -1;
-    total += r;
-    if(r != m)
-      break;
   }
-  return total;
+  return copyinstr(p->pagetable, dst, src, max);
 }
 
-uint64
-sys_write(void) {
-  int fd, n;
-  uint64 src;
-  if(argint(0, &fd) < 0 || argaddr(1, &src) < 0 || argint(2, &n) < 0)
-    return -1;
+// fd_* take the process explicitly so the submission ring's poller can
+// run them on behalf of the ring's owner. off < 0 uses the file offset.
+static int
+fd_io(struct proc *p, int fd, int write, uint64 addr, int n, int off) {
   if(n < 0)
     return -1;
-  struct proc *p = myproc();
+
+  struct file *f = fdget(p, fd);
+  if(f) {
+    int r = fileio(f, write, p->pagetable, addr, n, off);
+    fileclose(f);
+    return r;
+  }
 
   // allow stdout/stderr even if not explicitly opened
-  if((fd == 1 || fd == 2) && (fd >= NOFILE || p->ofile[fd] == 0)) {
+  if(write && (fd == 1 || fd == 2)) {
+    if(off >= 0)
+      return -1;
     char tmp[128];
     int written = 0;
     while(written < n) {
       int m = MIN(n - written, (int)sizeof(tmp));
-      if(copy_from_user(p, src + written, tmp, m) < 0)
+      if(copy_from_user(p, addr + written, tmp, m) < 0)
         return -1;
       for(int i = 0; i < m; i++)
         console_putc(tmp[i]);
@@ -108,42 +131,149 @@ sys_write(void) {
     }
     return written;
   }
+  return -1;
+}
 
-  if(fd < 0 || fd >= NOFILE)
+int
+fd_read(struct proc *p, int fd, uint64 dst, int n) {
+  return fd_io(p, fd, 0, dst, n, -1);
+}
+
+int
+fd_write(struct proc *p, int fd, uint64 src, int n) {
+  return fd_io(p, fd, 1, src, n, -1);
+}
+
+// The iovec array is copied in once; each vector is one fileio call,
+// and so one log transaction for writes that fit in one. Stops at the
+// first short transfer like read/write do.
+static int
+fd_iov(struct proc *p, int fd, int write, uint64 uiov, int iovcnt) {
+  struct iovec iov[UIO_MAXIOV];
+
+  if(iovcnt < 0 || iovcnt > UIO_MAXIOV)
     return -1;
-  struct file *f = p->ofile[fd];
-  if(f == 0)
+  if(copy_from_user(p, uiov, (char *)iov, iovcnt * sizeof(iov[0])) < 0)
     return -1;
 
-  char buf[BSIZE];
   int total = 0;
-  while(total < n) {
-    int m = MIN(n - total, (int)sizeof(buf));
-    if(copy_from_user(p, src + total, buf, m) < 0)
-      return -1;
-    int r = filewrite(f, buf, m);
+  for(int i = 0; i < iovcnt; i++) {
+    int n = (int)iov[i].iov_len;
+    if(n < 0 || total + n < total)
+      return total ? total : -1;
+    int r = fd_io(p, fd, write, iov[i].iov_base, n, -1);
     if(r < 0)
       return total ? total : -1;
     total += r;
-    if(r != m)
+    if(r != n)
       break;
   }
   return total;
 }
 
+int
+fd_close(struct proc *p, int fd) {
+  struct file *f = fdclear(p, fd);
+  if(f == 0)
+    return -1;
+  fileclose(f);
+  return 0;
+}
+
+uint64
+sys_read(void) {
+  int fd, n;
+  uint64 dst;
+  if(argint(0, &fd) < 0 || argaddr(1, &dst) < 0 || argint(2, &n) < 0)
+    return -1;
+  return fd_read(myproc(), fd, dst, n);
+}
+
+uint64
+sys_write(void) {
+  int fd, n;
+  uint64 src;
+  if(argint(0, &fd) < 0 || argaddr(1, &src) < 0 || argint(2, &n) < 0)
+    return -1;
+  return fd_write(myproc(), fd, src, n);
+}
+
+// readv(fd, iov, iovcnt) / writev(fd, iov, iovcnt)
+uint64
+sys_readv(void) {
+  int fd, iovcnt;
+  uint64 iov;
+  if(argint(0, &fd) < 0 || argaddr(1, &iov) < 0 || argint(2, &iovcnt) < 0)
+    return -1;
+  return fd_iov(myproc(), fd, 0, iov, iovcnt);
+}
+
+uint64
+sys_writev(void) {
+  int fd, iovcnt;
+  uint64 iov;
+  if(argint(0, &fd) < 0 || argaddr(1, &iov) < 0 || argint(2, &iovcnt) < 0)
+    return -1;
+  return fd_iov(myproc(), fd, 1, iov, iovcnt);
+}
+
+// pread(fd, buf, n, off) / pwrite(fd, buf, n, off): explicit offset,
+// the file offset is neither used nor changed
+uint64
+sys_pread(void) {
+  int fd, n, off;
+  uint64 dst;
+  if(argint(0, &fd) < 0 || argaddr(1, &dst) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return fd_io(myproc(), fd, 0, dst, n, off);
+}
+
+uint64
+sys_pwrite(void) {
+  int fd, n, off;
+  uint64 src;
+  if(argint(0, &fd) < 0 || argaddr(1, &src) < 0 || argint(2, &n) < 0 || argint(3, &off) < 0)
+    return -1;
+  if(off < 0)
+    return -1;
+  return fd_io(myproc(), fd, 1, src, n, off);
+}
+
 uint64
 sys_close(void) {
   int fd;
   if(argint(0, &fd) < 0)
     return -1;
+  return fd_close(myproc(), fd);
+}
+
+// pipe(fdarray): fdarray[0] reads, fdarray[1] writes
+uint64
+sys_pipe(void) {
+  uint64 fdarray;
+  if(argaddr(0, &fdarray) < 0)
+    return -1;
   struct proc *p = myproc();
-  if(fd < 0 || fd >= NOFILE)
+  struct file *rf, *wf;
+  if(pipealloc(&rf, &wf) < 0)
     return -1;
-  struct file *f = p->ofile[fd];
-  if(f == 0)
+  int fd[2] = {-1, -1};
+  if((fd[0] = fdalloc(p, rf)) < 0 || (fd[1] = fdalloc(p, wf)) < 0) {
+    if(fd[0] >= 0)
+      fdclear(p, fd[0]);
+    fileclose(rf);
+    fileclose(wf);
     return -1;
-  p->ofile[fd] = 0;
-  fileclose(f);
+  }
+  if(copy_to_user(p, fdarray, (char *)fd, sizeof(fd)) < 0) {
+    fdclear(p, fd[0]);
+    fdclear(p, fd[1]);
+    fileclose(rf);
+    fileclose(wf);
+    return -1;
+  }
   return 0;
 }
 
@@ -154,26 +284,21 @@ sys_fstat(void) {
   if(argint(0, &fd) < 0 || argaddr(1, &addr) < 0)
     return -1;
   struct proc *p = myproc();
-  if(fd < 0 || fd >= NOFILE)
-    return -1;
-  struct file *f = p->ofile[fd];
+  struct file *f = fdget(p, fd);
   if(f == 0)
     return -1;
   struct stat st;
-  if(filestat(f, &st) < 0)
+  int r = filestat(f, &st);
+  fileclose(f);
+  if(r < 0)
     return -1;
   if(copy_to_user(p, addr, (char *)&st, sizeof(st)) < 0)
     return -1;
   return 0;
 }
 
-uint64
-sys_open(void) {
-  char path[128];
-  int omode;
-  if(argstr(0, path, sizeof(path)) < 0 || argint(1, &omode) < 0)
-    return -1;
-
+int
+fd_open(struct proc *p, char *path, int omode) {
   struct file *f;
   struct inode *ip;
 
@@ -210,7 +335,7 @@ sys_open(void) {
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
 
-  int fd = fdalloc(myproc(), f);
+  int fd = fdalloc(p, f);
   if(fd < 0) {
     fileclose(f);
     iunlockput(ip);
@@ -223,6 +348,15 @@ sys_open(void) {
   return fd;
 }
 
+uint64
+sys_open(void) {
+  char path[128];
+  int omode;
+  if(argstr(0, path, sizeof(path)) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return fd_open(myproc(), path, omode);
+}
+
 uint64
 sys_chdir(void) {
   char path[128];
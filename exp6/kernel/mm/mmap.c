@@ -0,0 +1,476 @@
+#include "defs.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "proc.h"
+#include "mmap.h"
+#include "kalloc.h"
+#include "panic.h"
+#include "string.h"
+#include "vm.h"
+
+// One mapping. Pages are faulted in lazily; the VMA only records where
+// they come from. Only the owning process touches its VMAs.
+struct vma {
+  uint64 addr;        // page aligned, 0 if the slot is free
+  uint64 len;         // multiple of PGSIZE
+  int prot;
+  int flags;
+  struct file *f;
+  uint off;           // file offset of addr, page aligned
+};
+
+// A file page shared by every MAP_SHARED and every read-only MAP_PRIVATE
+// mapping of it. It lives as long as some PTE points at it. Shared pages
+// are mapped read-only until the first store, which marks them dirty.
+struct mpage {
+  struct inode *ip;
+  uint pgoff;         // file offset / PGSIZE
+  char *pa;
+  int ref;            // PTEs mapping the page
+  int writers;        // of those, how many are writable
+  int dirty;          // stored to since the last writeback
+};
+
+// Every page of a cached mapping has a slot set aside from sys_mmap until
+// it is faulted in or unmapped, so a fault never finds the table full.
+// exec text takes a slot only if that leaves the reservations intact.
+static struct spinlock mmap_lock;   // protects mpages, nused, nreserved
+static struct vma vmas[NPROC][NVMA];
+static struct mpage mpages[NMPAGE];
+static int nused;                   // mpages with ref > 0
+static int nreserved;               // cached mapping pages not yet faulted in
+
+void
+mmapinit(void) {
+  initlock(&mmap_lock, "mmap");
+}
+
+static uint64
+window_base(struct proc *p) {
+  return MMAP_BASE + (uint64)(p - proc) * MMAP_WINDOW;
+}
+
+static pagetable_t
+mmap_pagetable(struct proc *p) {
+  return p->pagetable ? p->pagetable : kernel_pagetable;
+}
+
+// pages come from the shared cache unless the mapping is private and writable
+static int
+vma_cached(struct vma *v) {
+  return (v->flags & MAP_SHARED) || !(v->prot & PROT_WRITE);
+}
+
+static struct vma*
+vma_find(struct proc *p, uint64 va) {
+  for(struct vma *v = vmas[p - proc]; v < vmas[p - proc] + NVMA; v++)
+    if(v->addr && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// lowest gap of len bytes in p's window, or 0
+static uint64
+vma_place(struct proc *p, uint64 len) {
+  uint64 base = window_base(p);
+  uint64 a = base;
+  int moved = 1;
+
+  while(moved) {
+    moved = 0;
+    for(struct vma *v = vmas[p - proc]; v < vmas[p - proc] + NVMA; v++) {
+      if(v->addr && a < v->addr + v->len && v->addr < a + len) {
+        a = v->addr + v->len;
+        moved = 1;
+      }
+    }
+  }
+  if(a + len > base + MMAP_WINDOW)
+    return 0;
+  return a;
+}
+
+// Read the page at off into pa, zero past EOF.
+static void
+fill_page(struct inode *ip, char *pa, uint off) {
+  memset(pa, 0, PGSIZE);
+  ilock(ip);
+  if(off < ip->size)
+    readi(ip, (uint64)pa, off, MIN(PGSIZE, ip->size - off));
+  iunlock(ip);
+}
+
+// Write the page at off back through the log. Never extends the file.
+static void
+writeback_page(struct inode *ip, char *pa, uint off) {
+  begin_op();
+  ilock(ip);
+  if(off < ip->size)
+    writei(ip, (uint64)pa, off, MIN(PGSIZE, ip->size - off));
+  iunlock(ip);
+  end_op();
+}
+
+static struct mpage*
+mpage_lookup(struct inode *ip, uint pgoff) {
+  for(struct mpage *m = mpages; m < mpages + NMPAGE; m++)
+    if(m->ref > 0 && m->ip == ip && m->pgoff == pgoff)
+      return m;
+  return 0;
+}
+
+// Take a reference on the cached page, reading it in on first use.
+// reserved says the caller holds a reservation, which is used up.
+static struct mpage*
+mpage_get(struct inode *ip, uint pgoff, int reserved) {
+  struct mpage *m;
+
+  acquire(&mmap_lock);
+  if((m = mpage_lookup(ip, pgoff)) != 0) {
+    m->ref++;
+    if(reserved)
+      nreserved--;
+    release(&mmap_lock);
+    return m;
+  }
+  if(!reserved && nused + 1 + nreserved > NMPAGE) {
+    release(&mmap_lock);
+    return 0;
+  }
+  release(&mmap_lock);
+
+  char *pa = kalloc();
+  if(pa == 0)
+    return 0;
+  fill_page(ip, pa, pgoff * PGSIZE);
+
+  acquire(&mmap_lock);
+  if((m = mpage_lookup(ip, pgoff)) != 0) {
+    // someone else read it in meanwhile
+    m->ref++;
+    if(reserved)
+      nreserved--;
+    release(&mmap_lock);
+    kfree(pa);
+    return m;
+  }
+  if(!reserved && nused + 1 + nreserved > NMPAGE) {
+    release(&mmap_lock);
+    kfree(pa);
+    return 0;
+  }
+  for(m = mpages; m < mpages + NMPAGE; m++) {
+    if(m->ref == 0) {
+      m->ip = ip;
+      m->pgoff = pgoff;
+      m->pa = pa;
+      m->ref = 1;
+      m->writers = 0;
+      m->dirty = 0;
+      nused++;
+      if(reserved)
+        nreserved--;
+      release(&mmap_lock);
+      return m;
+    }
+  }
+  panic("mpage_get: no free slot");
+}
+
+// Drop a PTE's reference. A writable PTE going away flushes a dirty page
+// so munmap makes the data durable; the last reference frees the page.
+static void
+mpage_put(struct mpage *m, int writable) {
+  acquire(&mmap_lock);
+  struct inode *ip = m->ip;
+  char *pa = m->pa;
+  uint off = m->pgoff * PGSIZE;
+  int flush = m->dirty && writable;
+  if(writable)
+    m->writers--;
+  if(flush && m->writers == 0)
+    m->dirty = 0;
+  int last = --m->ref == 0;
+  if(last)
+    nused--;
+  release(&mmap_lock);
+
+  if(flush)
+    writeback_page(ip, pa, off);
+  if(last)
+    kfree(pa);
+}
+
+// Read-only file pages for exec: text of the same binary is shared with
+// every other process running it and with read-only mappings of it.
+// Returns 0 when no slot is free; the caller then makes a private copy.
+char*
+mmap_getpage(struct inode *ip, uint pgoff) {
+  struct mpage *m = mpage_get(ip, pgoff, 0);
+  return m ? m->pa : 0;
+}
+
+// Drop exec's reference on pa. Returns -1 if pa is not the cached page,
+// i.e. a private copy the caller must free.
+int
+mmap_putpage(struct inode *ip, uint pgoff, char *pa) {
+  acquire(&mmap_lock);
+  struct mpage *m = mpage_lookup(ip, pgoff);
+  release(&mmap_lock);
+  if(m == 0 || m->pa != pa)
+    return -1;
+  mpage_put(m, 0);
+  return 0;
+}
+
+// Page fault on va in p. Returns 0 if the access can be retried.
+// read/write on a buffer mapped from the same file would fault with the
+// inode locked; that is not supported.
+int
+mmap_fault(struct proc *p, uint64 va, int write) {
+  struct vma *v;
+  if(p == 0 || (v = vma_find(p, va)) == 0)
+    return -1;
+  if(!(v->prot & (write ? PROT_WRITE : PROT_READ | PROT_WRITE)))
+    return -1;
+
+  pagetable_t pt = mmap_pagetable(p);
+  va = PGROUNDDOWN(va);
+  uint pgoff = (v->off + (va - v->addr)) / PGSIZE;
+  struct inode *ip = v->f->ip;
+
+  pte_t *pte = walk(pt, va, 0);
+  if(pte && (*pte & PTE_V)) {
+    // first store to a clean shared page
+    if(write && (*pte & PTE_W) == 0) {
+      acquire(&mmap_lock);
+      struct mpage *m = mpage_lookup(ip, pgoff);
+      if(m) {
+        m->dirty = 1;
+        m->writers++;
+      }
+      release(&mmap_lock);
+      *pte |= PTE_W;
+    }
+    sfence_vma();
+    return 0;
+  }
+
+  char *pa;
+  int perm = PTE_R;
+  struct mpage *m = 0;
+  if(vma_cached(v)) {
+    if((m = mpage_get(ip, pgoff, 1)) == 0)
+      return -1;
+    pa = m->pa;
+    if(write) {
+      acquire(&mmap_lock);
+      m->dirty = 1;
+      m->writers++;
+      release(&mmap_lock);
+      perm |= PTE_W;
+    }
+  } else {
+    if((pa = kalloc()) == 0)
+      return -1;
+    fill_page(ip, pa, pgoff * PGSIZE);
+    perm |= PTE_W;
+  }
+  if(p->pagetable)
+    perm |= PTE_U;
+
+  if(mappages(pt, va, PGSIZE, (uint64)pa, perm) != 0) {
+    if(m) {
+      mpage_put(m, write);
+      acquire(&mmap_lock);
+      nreserved++;
+      release(&mmap_lock);
+    } else {
+      kfree(pa);
+    }
+    return -1;
+  }
+  sfence_vma();
+  return 0;
+}
+
+// Unmap the resident pages of [va, va+len), which lies inside v, and
+// give back the reservations of the pages that never faulted in.
+static void
+vma_unmap(struct proc *p, struct vma *v, uint64 va, uint64 len) {
+  pagetable_t pt = mmap_pagetable(p);
+
+  for(uint64 a = va; a < va + len; a += PGSIZE) {
+    pte_t *pte = walk(pt, a, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0) {
+      if(vma_cached(v)) {
+        acquire(&mmap_lock);
+        nreserved--;
+        release(&mmap_lock);
+      }
+      continue;
+    }
+    char *pa = (char *)PTE2PA(*pte);
+    int writable = (*pte & PTE_W) != 0;
+    *pte = 0;
+    sfence_vma();
+
+    if(!vma_cached(v)) {
+      kfree(pa);
+      continue;
+    }
+    uint pgoff = (v->off + (a - v->addr)) / PGSIZE;
+    acquire(&mmap_lock);
+    struct mpage *m = mpage_lookup(v->f->ip, pgoff);
+    release(&mmap_lock);
+    if(m == 0)
+      panic("vma_unmap: page not cached");
+    mpage_put(m, writable);
+  }
+}
+
+static void
+vma_free(struct vma *v) {
+  struct file *f = v->f;
+  v->addr = 0;
+  v->len = 0;
+  v->f = 0;
+  fileclose(f);
+}
+
+// mmap(addr, len, prot, flags, fd, off): addr is only a hint and is
+// ignored. off must be page aligned. Returns the mapping or -1.
+uint64
+sys_mmap(void) {
+  uint64 len;
+  int prot, flags, fd, off;
+  if(argaddr(1, &len) < 0 || argint(2, &prot) < 0 || argint(3, &flags) < 0 ||
+     argint(4, &fd) < 0 || argint(5, &off) < 0)
+    return -1;
+  struct proc *p = myproc();
+
+  if(len == 0 || len > MMAP_WINDOW || off < 0 || off % PGSIZE != 0)
+    return -1;
+  if((flags & (MAP_SHARED | MAP_PRIVATE)) == 0 ||
+     (flags & (MAP_SHARED | MAP_PRIVATE)) == (MAP_SHARED | MAP_PRIVATE))
+    return -1;
+  struct file *f = fdget(p, fd);
+  if(f == 0)
+    return -1;
+  if(f->type != FD_INODE || !f->readable ||
+     ((flags & MAP_SHARED) && (prot & PROT_WRITE) && !f->writable)) {
+    fileclose(f);
+    return -1;
+  }
+
+  len = PGROUNDUP(len);
+  struct vma *v = 0;
+  for(struct vma *s = vmas[p - proc]; s < vmas[p - proc] + NVMA; s++) {
+    if(s->addr == 0) {
+      v = s;
+      break;
+    }
+  }
+  uint64 addr;
+  if(v == 0 || (addr = vma_place(p, len)) == 0) {
+    fileclose(f);
+    return -1;
+  }
+  v->prot = prot;
+  v->flags = flags;
+  if(vma_cached(v)) {
+    acquire(&mmap_lock);
+    if(nused + nreserved + len / PGSIZE > NMPAGE) {
+      release(&mmap_lock);
+      fileclose(f);
+      return -1;
+    }
+    nreserved += len / PGSIZE;
+    release(&mmap_lock);
+  }
+
+  v->len = len;
+  v->f = f;           // the reference from fdget
+  v->off = off;
+  v->addr = addr;
+  return addr;
+}
+
+// munmap(addr, len): the range must cover the start or the end of a
+// mapping (or all of it); punching holes is not supported.
+uint64
+sys_munmap(void) {
+  uint64 addr, len;
+  if(argaddr(0, &addr) < 0 || argaddr(1, &len) < 0)
+    return -1;
+  struct proc *p = myproc();
+  struct vma *v = vma_find(p, addr);
+  if(v == 0 || addr % PGSIZE != 0 || len == 0)
+    return -1;
+
+  len = PGROUNDUP(len);
+  if(addr + len > v->addr + v->len)
+    return -1;
+  if(addr != v->addr && addr + len != v->addr + v->len)
+    return -1;
+
+  vma_unmap(p, v, addr, len);
+  if(addr == v->addr) {
+    v->addr += len;
+    v->off += len;
+  }
+  v->len -= len;
+  if(v->len == 0)
+    vma_free(v);
+  return 0;
+}
+
+// msync(addr, len): write dirty pages of a shared mapping back through
+// the log. Pages nobody else maps writable go back to read-only so the
+// next store dirties them again.
+uint64
+sys_msync(void) {
+  uint64 addr, len;
+  if(argaddr(0, &addr) < 0 || argaddr(1, &len) < 0)
+    return -1;
+  struct proc *p = myproc();
+  struct vma *v = vma_find(p, addr);
+  if(v == 0 || addr % PGSIZE != 0)
+    return -1;
+  if(!(v->flags & MAP_SHARED) || !(v->prot & PROT_WRITE))
+    return 0;
+
+  uint64 end = MIN(addr + PGROUNDUP(len), v->addr + v->len);
+  pagetable_t pt = mmap_pagetable(p);
+  for(uint64 a = addr; a < end; a += PGSIZE) {
+    pte_t *pte = walk(pt, a, 0);
+    if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_W) == 0)
+      continue;
+    uint pgoff = (v->off + (a - v->addr)) / PGSIZE;
+    acquire(&mmap_lock);
+    struct mpage *m = mpage_lookup(v->f->ip, pgoff);
+    int flush = m && m->dirty;
+    if(flush && m->writers == 1) {
+      m->dirty = 0;
+      m->writers = 0;
+      *pte &= ~PTE_W;
+      sfence_vma();
+    }
+    release(&mmap_lock);
+    if(flush)
+      writeback_page(v->f->ip, m->pa, pgoff * PGSIZE);
+  }
+  return 0;
+}
+
+// Tear down every mapping of p. Called from exit_process before the
+// file table is closed.
+void
+mmap_release(struct proc *p) {
+  for(struct vma *v = vmas[p - proc]; v < vmas[p - proc] + NVMA; v++) {
+    if(v->addr) {
+      vma_unmap(p, v, v->addr, v->len);
+      vma_free(v);
+    }
+  }
+}
@@ -3,13 +3,15 @@
 #include "panic.h"
 #include "string.h"
 #include "vm.h"
+#include "proc.h"
+#include "exec.h"
+#include "mmap.h"
 
 extern char end[]; // first address after kernel
 
 pagetable_t kernel_pagetable;
 
 static void kvmmap(uint64 va, uint64 pa, uint64 sz, int perm);
-static int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm);
 static void freewalk(pagetable_t pagetable);
 uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz);
 void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free);
@@ -73,7 +75,7 @@ pte_t *walk(pagetable_t pagetable, uint64 va, int alloc) {
   return &pagetable[VPN_MASK(va, 0)];
 }
 
-static int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm) {
+int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm) {
   uint64 a, last;
   pte_t *pte;
 
@@ -238,12 +240,35 @@ uint64 walkaddr(pagetable_t pagetable, uint64 va) {
   return pa;
 }
 
+// Physical address of the user page at va for copyin/copyout, faulting in
+// lazily loaded pages of the current process. 0 if va is not mapped, or
+// not writable when write is set.
+static uint64 uvmresolve(pagetable_t pagetable, uint64 va, int write) {
+  struct proc *p = myproc();
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    return 0;
+  pte = walk(pagetable, va, 0);
+  if((pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_W) == 0)) &&
+     p && p->pagetable == pagetable) {
+    if(exec_fault(p, va, write ? FAULT_WRITE : FAULT_READ) == 0 ||
+       mmap_fault(p, va, write) == 0)
+      pte = walk(pagetable, va, 0);
+  }
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0)
+    return 0;
+  if(write && (*pte & PTE_W) == 0)
+    return 0;
+  return PTE2PA(*pte);
+}
+
 int copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len) {
   uint64 n, va0, pa0;
 
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmresolve(pagetable, va0, 1);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
@@ -263,7 +288,7 @@ int copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len) {
 
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmresolve(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -284,7 +309,7 @@ int copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max) {
 
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmresolve(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
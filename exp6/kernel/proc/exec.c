@@ -0,0 +1,331 @@
+#include "defs.h"
+#include "elf.h"
+#include "exec.h"
+#include "fs.h"
+#include "proc.h"
+#include "mmap.h"
+#include "ring.h"
+#include "kalloc.h"
+#include "panic.h"
+#include "string.h"
+#include "trap.h"
+#include "vm.h"
+
+// One PT_LOAD segment. exec reads nothing but the headers; pages are
+// filled in by exec_fault on first touch.
+struct seg {
+  uint64 vaddr;
+  uint64 filesz;
+  uint64 memsz;
+  uint64 off;         // file offset of vaddr
+  int flags;          // ELF_PROG_FLAG_*
+};
+
+// Where the pages of a process's user image come from. Only the owning
+// process touches its image.
+struct image {
+  struct inode *ip;   // the executable, referenced while the image lives
+  struct seg seg[NSEG];
+  int nseg;
+  uint64 stack;       // lowest user stack page, 0 if not yet mapped
+};
+
+static struct image images[NPROC];
+
+// Read-only segments without bss map the file pages straight from the
+// shared page cache, so every process running a binary shares its text.
+// Everything else, and shared pages the cache has no room for, gets a
+// private copy.
+static int
+seg_shared(struct seg *s) {
+  return !(s->flags & ELF_PROG_FLAG_WRITE) && s->filesz == s->memsz;
+}
+
+static struct seg*
+seg_find(struct image *im, uint64 va) {
+  for(struct seg *s = im->seg; s < im->seg + im->nseg; s++)
+    if(va >= PGROUNDDOWN(s->vaddr) && va < s->vaddr + s->memsz)
+      return s;
+  return 0;
+}
+
+// file page backing the (page aligned) va of a segment
+static uint
+seg_pgoff(struct seg *s, uint64 va) {
+  return (s->off + (va - s->vaddr)) / PGSIZE;
+}
+
+// Copy the file bytes of the segment that fall in the page at va; the
+// rest of the page, bss included, stays zero.
+static void
+seg_fill(struct inode *ip, struct seg *s, char *pa, uint64 va) {
+  uint64 start = va > s->vaddr ? va : s->vaddr;
+  uint64 end = MIN(va + PGSIZE, s->vaddr + s->filesz);
+
+  memset(pa, 0, PGSIZE);
+  if(start >= end)
+    return;
+  ilock(ip);
+  readi(ip, (uint64)pa + (start - va), s->off + (start - s->vaddr), end - start);
+  iunlock(ip);
+}
+
+// Page fault on va in p's image. Returns 0 if the access can be retried.
+// Like mmap_fault, this reads the executable, so a read or write of the
+// executable itself into a not yet faulted buffer is not supported.
+int
+exec_fault(struct proc *p, uint64 va, int kind) {
+  struct image *im;
+  struct seg *s;
+
+  if(p == 0 || p->pagetable == 0)
+    return -1;
+  im = &images[p - proc];
+  if(im->ip == 0 || (s = seg_find(im, va)) == 0)
+    return -1;
+  if(kind == FAULT_WRITE && !(s->flags & ELF_PROG_FLAG_WRITE))
+    return -1;
+  if(kind == FAULT_EXEC && !(s->flags & ELF_PROG_FLAG_EXEC))
+    return -1;
+
+  va = PGROUNDDOWN(va);
+  pte_t *pte = walk(p->pagetable, va, 0);
+  if(pte && (*pte & PTE_V)) {
+    // already filled in, the TLB was stale
+    sfence_vma();
+    return 0;
+  }
+
+  int perm = PTE_U | PTE_R;
+  if(s->flags & ELF_PROG_FLAG_WRITE)
+    perm |= PTE_W;
+  if(s->flags & ELF_PROG_FLAG_EXEC)
+    perm |= PTE_X;
+
+  // a full page cache falls back to a private copy
+  char *pa = 0;
+  if(seg_shared(s))
+    pa = mmap_getpage(im->ip, seg_pgoff(s, va));
+  if(pa == 0) {
+    if((pa = kalloc()) == 0)
+      return -1;
+    seg_fill(im->ip, s, pa, va);
+  }
+  if(mappages(p->pagetable, va, PGSIZE, (uint64)pa, perm) != 0) {
+    if(!seg_shared(s) || mmap_putpage(im->ip, seg_pgoff(s, va), pa) < 0)
+      kfree(pa);
+    return -1;
+  }
+  sfence_vma();
+  return 0;
+}
+
+// A user page table with the trampoline and p's trapframe mapped.
+static pagetable_t
+image_pagetable(struct proc *p) {
+  pagetable_t pt = uvmcreate();
+  if(pt == 0)
+    return 0;
+  if(mappages(pt, TRAMPOLINE, PGSIZE, (uint64)trampoline, PTE_R | PTE_X) != 0) {
+    uvmfree(pt, 0);
+    return 0;
+  }
+  if(mappages(pt, TRAPFRAME, PGSIZE, (uint64)p->trapframe, PTE_R | PTE_W) != 0) {
+    uvmunmap(pt, TRAMPOLINE, 1, 0);
+    uvmfree(pt, 0);
+    return 0;
+  }
+  return pt;
+}
+
+// Unmap the resident pages of an image, free its page table and drop the
+// executable.
+static void
+image_free(pagetable_t pt, struct image *im) {
+  for(struct seg *s = im->seg; s < im->seg + im->nseg; s++) {
+    for(uint64 a = PGROUNDDOWN(s->vaddr); a < s->vaddr + s->memsz; a += PGSIZE) {
+      pte_t *pte = walk(pt, a, 0);
+      if(pte == 0 || (*pte & PTE_V) == 0)
+        continue;
+      char *pa = (char *)PTE2PA(*pte);
+      if(!seg_shared(s) || mmap_putpage(im->ip, seg_pgoff(s, a), pa) < 0)
+        kfree(pa);
+      *pte = 0;
+    }
+  }
+  if(im->stack)
+    uvmunmap(pt, im->stack, USTACK_PAGES, 1);
+  uvmunmap(pt, TRAMPOLINE, 1, 0);
+  uvmunmap(pt, TRAPFRAME, 1, 0);
+  uvmfree(pt, 0);
+
+  if(im->ip) {
+    begin_op();
+    iput(im->ip);
+    end_op();
+  }
+  memset(im, 0, sizeof(*im));
+}
+
+// Replace p's user image with the executable at path. Only the ELF and
+// program headers are read here; the user stack below holds argv.
+// Returns argc, which ends up in a0, with argv in a1.
+int
+exec(char *path, char **argv) {
+  struct proc *p = myproc();
+  struct image im;
+  struct elfhdr elf;
+  struct proghdr ph;
+  struct inode *ip;
+  pagetable_t pt = 0;
+  uint64 top = 0, sp, stackbase, ustack[MAXARG + 1];
+  int argc;
+
+  memset(&im, 0, sizeof(im));
+  begin_op();
+  if((ip = namei(path)) == 0) {
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+
+  if(readi(ip, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf) || elf.magic != ELF_MAGIC)
+    goto bad;
+  uint64 off = elf.phoff;
+  for(int i = 0; i < elf.phnum; i++, off += sizeof(ph)) {
+    if(readi(ip, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
+      goto bad;
+    if(ph.type != ELF_PROG_LOAD || ph.memsz == 0)
+      continue;
+    if(ph.memsz < ph.filesz || ph.vaddr + ph.memsz < ph.vaddr)
+      goto bad;
+    // below the mmap windows; pages fault in one segment at a time, so
+    // segments must be sorted and must not share a page
+    if(ph.vaddr + ph.memsz > MMAP_BASE || PGROUNDDOWN(ph.vaddr) < top)
+      goto bad;
+    if(ph.vaddr % PGSIZE != ph.off % PGSIZE || ph.off + ph.filesz > ip->size)
+      goto bad;
+    if(im.nseg == NSEG)
+      goto bad;
+    struct seg *s = &im.seg[im.nseg++];
+    s->vaddr = ph.vaddr;
+    s->filesz = ph.filesz;
+    s->memsz = ph.memsz;
+    s->off = ph.off;
+    s->flags = ph.flags;
+    top = PGROUNDUP(ph.vaddr + ph.memsz);
+  }
+  if(im.nseg == 0)
+    goto bad;
+  iunlock(ip);
+  end_op();
+  im.ip = ip;     // the image keeps the reference
+  ip = 0;
+
+  if((pt = image_pagetable(p)) == 0)
+    goto bad;
+
+  // one unmapped guard page, then the stack
+  stackbase = top + PGSIZE;
+  if(uvmalloc(pt, stackbase, stackbase + USTACK_PAGES * PGSIZE, PTE_W) == 0)
+    goto bad;
+  im.stack = stackbase;
+  sp = stackbase + USTACK_PAGES * PGSIZE;
+
+  for(argc = 0; argv[argc]; argc++) {
+    if(argc >= MAXARG)
+      goto bad;
+    sp -= strlen(argv[argc]) + 1;
+    sp -= sp % 16;
+    if(sp < stackbase || copyout(pt, sp, argv[argc], strlen(argv[argc]) + 1) < 0)
+      goto bad;
+    ustack[argc] = sp;
+  }
+  ustack[argc] = 0;
+  sp -= (argc + 1) * sizeof(uint64);
+  sp -= sp % 16;
+  if(sp < stackbase || copyout(pt, sp, (char *)ustack, (argc + 1) * sizeof(uint64)) < 0)
+    goto bad;
+
+  // Past the point of no return. The old ring and mappings lived in the
+  // old address space.
+  ring_release(p);
+  mmap_release(p);
+
+  pagetable_t oldpt = p->pagetable;
+  struct image old = images[p - proc];
+  images[p - proc] = im;
+  p->pagetable = pt;
+  p->sz = stackbase + USTACK_PAGES * PGSIZE;
+  p->trapframe->epc = elf.entry;
+  p->trapframe->sp = sp;
+  p->trapframe->a1 = sp;
+
+  char *last = path;
+  for(char *s = path; *s; s++)
+    if(*s == '/')
+      last = s + 1;
+  strlcpy(p->name, last, sizeof(p->name));
+
+  if(oldpt)
+    image_free(oldpt, &old);
+  return argc;
+
+bad:
+  if(ip) {
+    iunlockput(ip);
+    end_op();
+  }
+  if(pt) {
+    image_free(pt, &im);
+  } else if(im.ip) {
+    begin_op();
+    iput(im.ip);
+    end_op();
+  }
+  return -1;
+}
+
+// Tear down p's user image. Called from exit_process after the mmap
+// windows are gone.
+void
+exec_release(struct proc *p) {
+  if(p->pagetable == 0)
+    return;
+  image_free(p->pagetable, &images[p - proc]);
+  p->pagetable = 0;
+  p->sz = 0;
+}
+
+// exec(path, argv). A kernel thread that execs leaves the kernel for the
+// new image right away; a user process returns to it through usertrap.
+uint64
+sys_exec(void) {
+  char path[MAXPATH], *argv[MAXARG + 1];
+  uint64 uargv, uarg;
+  struct proc *p = myproc();
+  int from_kernel = p->pagetable == 0;
+  int ret = -1;
+
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0)
+    return -1;
+  memset(argv, 0, sizeof(argv));
+  for(int i = 0; ; i++) {
+    if(i > MAXARG || fetchaddr(uargv + sizeof(uint64) * i, &uarg) < 0)
+      goto out;
+    if(uarg == 0)
+      break;
+    if((argv[i] = kalloc()) == 0 || fetchstr(uarg, argv[i], PGSIZE) < 0)
+      goto out;
+  }
+  ret = exec(path, argv);
+
+out:
+  for(int i = 0; i <= MAXARG && argv[i]; i++)
+    kfree(argv[i]);
+  if(ret >= 0 && from_kernel) {
+    p->trapframe->a0 = ret;
+    usertrapret();
+  }
+  return ret;
+}
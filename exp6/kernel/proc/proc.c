@@ -6,8 +6,10 @@
 #include "vm.h"
 #include "trap.h"
 #include "fs.h"
+#include "ring.h"
+#include "mmap.h"
+#include "exec.h"
 
-#define KSTACK_SIZE PGSIZE
 
 struct proc proc[NPROC];
 static struct spinlock pid_lock;
@@ -28,6 +30,7 @@ procinit(void) {
   for(int i = 0; i < NPROC; i++) {
     struct proc *p = &proc[i];
     initlock(&p->lock, "proc");
+    initlock(&p->fdlock, "ofile");
     p->state = UNUSED;
     p->kstack = 0;
   }
@@ -100,9 +103,11 @@ freeproc(struct proc *p) {
   p->xstate = 0;
   p->pid = 0;
   p->parent = 0;
+  p->nowait = 0;
   for(int i = 0; i < NOFILE; i++)
     p->ofile[i] = 0;
   p->cwd = 0;
+  p->ring = 0;
   p->name[0] = '\0';
   p->state = UNUSED;
   p->kthread.start = 0;
@@ -173,8 +178,8 @@ proc_entry(void) {
   exit_process(0);
 }
 
-int
-create_process(const char *name, void (*fn)(void *), void *arg) {
+static int
+spawn(const char *name, void (*fn)(void *), void *arg, int nowait) {
   struct proc *p = alloc_process();
   if(p == 0)
     return -1;
@@ -188,17 +193,34 @@ create_process(const char *name, void (*fn)(void *), void *arg) {
   p->kthread.start = fn;
   p->kthread.arg = arg;
   p->parent = myproc();
+  p->nowait = nowait;
   p->state = RUNNABLE;
   release(&p->lock);
   return p->pid;
 }
 
+int
+create_process(const char *name, void (*fn)(void *), void *arg) {
+  return spawn(name, fn, arg, 0);
+}
+
+// A child that wait() does not see, for kernel threads the parent
+// starts and reaps itself with waitpid, like the ring poller.
+int
+create_helper(const char *name, void (*fn)(void *), void *arg) {
+  return spawn(name, fn, arg, 1);
+}
+
 void
 exit_process(int status) {
   struct proc *p = myproc();
   if(p == 0)
     panic("exit_process");
 
+  ring_release(p);
+  mmap_release(p);
+  exec_release(p);
+
   for(int fd = 0; fd < NOFILE; fd++) {
     if(p->ofile[fd]) {
       fileclose(p->ofile[fd]);
@@ -227,6 +249,12 @@ exit_process(int status) {
 
 int
 wait_process(int *status) {
+  return waitpid_process(-1, status);
+}
+
+// wait for the child with the given pid, or any child but helpers if pid < 0
+int
+waitpid_process(int pid, int *status) {
   struct proc *p = myproc();
   if(p == 0)
     panic("wait_process");
@@ -241,16 +269,16 @@ wait_process(int *status) {
       if(np == p)
         continue;
       acquire(&np->lock);
-      if(np->parent == p) {
+      if(np->parent == p && (pid < 0 ? !np->nowait : np->pid == pid)) {
         havekids = 1;
         if(np->state == ZOMBIE) {
-          int pid = np->pid;
+          int kpid = np->pid;
           if(status)
             *status = np->xstate;
           freeproc(np);
           release(&np->lock);
           release(&wait_lock);
-          return pid;
+          return kpid;
         }
       }
       release(&np->lock);
@@ -4,6 +4,9 @@
 #include "trap.h"
 #include "fs.h"
 #include "vm.h"
+#include "ring.h"
+#include "mmap.h"
+#include "exec.h"
 
 static struct pushregs *current_regs;
 
@@ -39,7 +42,19 @@ argaddr(int n, uint64 *ip) {
   return 0;
 }
 
-static int
+int
+fetchaddr(uint64 addr, uint64 *ip) {
+  struct proc *p = myproc();
+  if(p == 0)
+    return -1;
+  if(p->pagetable == 0) {
+    *ip = *(uint64 *)addr;
+    return 0;
+  }
+  return copyin(p->pagetable, (char *)ip, addr, sizeof(*ip));
+}
+
+int
 fetchstr(uint64 addr, char *buf, int max) {
   struct proc *p = myproc();
   if(p == 0)
@@ -69,6 +84,7 @@ static uint64 sys_unimplemented(void) { return (uint64)-1; }
 uint64 sys_read(void);
 uint64 sys_write(void);
 uint64 sys_open(void);
+uint64 sys_pipe(void);
 uint64 sys_close(void);
 uint64 sys_dup(void);
 uint64 sys_fstat(void);
@@ -76,6 +92,10 @@ uint64 sys_chdir(void);
 uint64 sys_mkdir(void);
 uint64 sys_mknod(void);
 uint64 sys_unlink(void);
+uint64 sys_readv(void);
+uint64 sys_writev(void);
+uint64 sys_pread(void);
+uint64 sys_pwrite(void);
 
 uint64 sys_sleep(void);
 uint64 sys_uptime(void);
@@ -84,10 +104,10 @@ static uint64 (*syscalls[])(void) = {
   [SYS_fork]    sys_unimplemented,
   [SYS_exit]    sys_exit,
   [SYS_wait]    sys_wait,
-  [SYS_pipe]    sys_unimplemented,
+  [SYS_pipe]    sys_pipe,
   [SYS_read]    sys_read,
   [SYS_kill]    sys_kill,
-  [SYS_exec]    sys_unimplemented,
+  [SYS_exec]    sys_exec,
   [SYS_fstat]   sys_fstat,
   [SYS_chdir]   sys_chdir,
   [SYS_dup]     sys_dup,
@@ -103,6 +123,15 @@ static uint64 (*syscalls[])(void) = {
   [SYS_mkdir]   sys_mkdir,
   [SYS_close]   sys_close,
   [SYS_yield]   sys_yield,
+  [SYS_ring_setup] sys_ring_setup,
+  [SYS_ring_enter] sys_ring_enter,
+  [SYS_readv]   sys_readv,
+  [SYS_writev]  sys_writev,
+  [SYS_pread]   sys_pread,
+  [SYS_pwrite]  sys_pwrite,
+  [SYS_mmap]    sys_mmap,
+  [SYS_munmap]  sys_munmap,
+  [SYS_msync]   sys_msync,
 };
 
 void
@@ -3,6 +3,8 @@
 #include "panic.h"
 #include "string.h"
 #include "proc.h"
+#include "mmap.h"
+#include "exec.h"
 
 #define INST_16_MASK 0x3
 
@@ -23,6 +25,7 @@ static inline void advance_sepc(struct trapframe *tf) {
 }
 
 extern void kernelvec(void);
+extern char uservec[], userret[];
 
 void trap_init(void) {
   memset((void *)irq_table, 0, sizeof(irq_table));
@@ -136,6 +139,85 @@ void kerneltrap(struct pushregs *regs) {
   w_sstatus(sstatus);
 }
 
+// syscall() takes its arguments from pushregs; a user process keeps its
+// registers in the trapframe.
+static void user_syscall(struct trapframe *tf) {
+  struct pushregs regs = {
+    .a0 = tf->a0, .a1 = tf->a1, .a2 = tf->a2, .a3 = tf->a3,
+    .a4 = tf->a4, .a5 = tf->a5, .a6 = tf->a6, .a7 = tf->a7,
+  };
+  syscall(tf, &regs);
+  tf->a0 = regs.a0;
+}
+
+// Trap from user mode. uservec has saved the user registers in the
+// trapframe and switched to the kernel page table and stack.
+void usertrap(void) {
+  if((r_sstatus() & SSTATUS_SPP) != 0)
+    panic("usertrap: not from user mode");
+  w_stvec((uint64)kernelvec);
+
+  struct proc *p = myproc();
+  struct trapframe *tf = p->trapframe;
+  uint64 scause = r_scause();
+  tf->epc = r_sepc();
+
+  if(scause & (1ULL << 63)) {
+    int irq = (int)(scause & 0xff);
+    dispatch_interrupt(irq);
+    if(irq == IRQ_S_TIMER)
+      yield();
+  } else if(scause == 8) {
+    if(p->killed)
+      exit_process(-1);
+    tf->epc += 4;
+    intr_on();
+    user_syscall(tf);
+  } else if(scause == 12 || scause == 13 || scause == 15) {
+    // lazily loaded image pages first, then mapped files
+    uint64 va = r_stval();
+    int kind = scause == 12 ? FAULT_EXEC : (scause == 15 ? FAULT_WRITE : FAULT_READ);
+    if(exec_fault(p, va, kind) != 0 &&
+       (kind == FAULT_EXEC || mmap_fault(p, va, kind == FAULT_WRITE) != 0)) {
+      printf("usertrap: pid %d fault %d at 0x%x\n", p->pid, (int)scause, (int)va);
+      p->killed = 1;
+    }
+  } else {
+    printf("usertrap: pid %d scause %d sepc 0x%x\n", p->pid, (int)scause, (int)tf->epc);
+    p->killed = 1;
+  }
+
+  if(p->killed)
+    exit_process(-1);
+  usertrapret();
+}
+
+// Return to user mode through userret on the trampoline.
+void usertrapret(void) {
+  struct proc *p = myproc();
+  struct trapframe *tf = p->trapframe;
+
+  // stvec points at the user vector until we are back in user mode
+  intr_off();
+  w_stvec(TRAMPOLINE + (uservec - trampoline));
+
+  tf->kernel_satp = r_satp();
+  tf->kernel_sp = p->kstack + KSTACK_SIZE;
+  tf->kernel_trap = (uint64)usertrap;
+  tf->kernel_hartid = r_tp();
+
+  uint64 sstatus = r_sstatus();
+  sstatus &= ~SSTATUS_SPP;    // sret to user mode
+  sstatus |= SSTATUS_SPIE;    // with interrupts on
+  w_sstatus(sstatus);
+  w_sepc(tf->epc);
+
+  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 fn = TRAMPOLINE + (userret - trampoline);
+  ((void (*)(uint64))fn)(satp);
+  panic("usertrapret");
+}
+
 static void set_next_timer_tick(void) {
   uint64 next = get_time() + TICK_INTERVAL;
   w_stimecmp(next);
@@ -187,11 +269,15 @@ static void handle_instruction_page_fault(struct trapframe *tf) {
 }
 
 static void handle_load_page_fault(struct trapframe *tf) {
+  if(mmap_fault(myproc(), tf->tval, 0) == 0)
+    return;
   printf("Load fault at 0x%x\n", (int)(tf->tval));
   advance_sepc(tf);
 }
 
 static void handle_store_page_fault(struct trapframe *tf) {
+  if(mmap_fault(myproc(), tf->tval, 1) == 0)
+    return;
   printf("Store fault at 0x%x\n", (int)(tf->tval));
   advance_sepc(tf);
 }
@@ -29,6 +29,15 @@ link
 mkdir
 close
 yield
+ring_setup
+ring_enter
+readv
+writev
+pread
+pwrite
+mmap
+munmap
+msync
 );
 
 for my $i (0 .. $#syscalls) {
@@ -11,6 +11,8 @@ void goto_xy(int col, int row);   /* \033[{row};{col}H */
 
 // printf.c
 int printf(const char *fmt, ...);
+void printfinit(void);
+void printf_disable_lock(void);
 void printfint(int x);
 
 #ifndef MIN
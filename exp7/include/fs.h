@@ -1,13 +1,17 @@
 #pragma once
 
 #include "riscv.h"
+#include "sleeplock.h"
 
 #define BSIZE      1024            /* block size in bytes */
 #define FSSIZE     1024            /* total blocks in ramdisk */
-#define LOGSIZE    30              /* max log blocks */
+#ifndef LOGSIZE
+#define LOGSIZE    64              /* log blocks incl. header, override with -DLOGSIZE= */
+#endif
 #define NINODE     64              /* number of in-memory inodes */
 #define NFILE      40              /* open files */
-#define NBUF       32              /* buffer cache entries */
+#define NBUF       (LOGSIZE + 16)  /* buffer cache entries; logged blocks stay pinned */
+#define NBUCKET    13              /* buffer cache hash buckets (prime) */
 
 #define ROOTINO    1               /* root i-number */
 #define DIRSIZ     14
@@ -62,13 +66,13 @@ struct buf {
   uint blockno;
   struct buf *prev;
   struct buf *next;
-  struct spinlock lock;
+  struct sleeplock lock;
   int refcnt;
   uchar data[BSIZE];
 };
 
 struct inode {
-  struct spinlock lock;
+  struct sleeplock lock;  /* protects everything below ref */
   int dev;
   int inum;
   int ref;
@@ -106,6 +110,8 @@ struct file {
 void fs_init(void);
 void begin_op(void);
 void end_op(void);
+int begin_op_n(int want);
+void end_op_n(int granted);
 void fs_test_samples(void);
 void fs_force_recovery(void);
 
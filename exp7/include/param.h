@@ -0,0 +1,5 @@
+#pragma once
+
+/* 同时被 C 和汇编（entry.S）包含，只放宏定义 */
+#define NPROC 32  /* 最大进程数 */
+#define NCPU  4   /* 最大 hart 数，需不小于 Makefile 中的 CPUS */
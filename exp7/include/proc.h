@@ -1,9 +1,7 @@
 #pragma once
 
 #include "riscv.h"
-
-#define NPROC 32
-#define NCPU  1
+#include "param.h"
 
 enum procstate {
   UNUSED = 0,
@@ -33,11 +31,29 @@ struct context {
 
 struct proc;
 
+// sleepers hashed by channel address, so wakeup() only looks at
+// processes actually waiting on a channel that hashes alike.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+};
+
+// per-CPU run queue of RUNNABLE processes, FIFO through proc.rq_next.
+// lock order: p->lock before rq.lock; never hold two rq locks at once.
+struct runq {
+  struct spinlock lock;
+  struct proc *head;
+  struct proc *tail;
+  int len;
+};
+
 struct cpu {
   struct proc *proc;
   struct context context;
   int noff;
   int intena;
+  int started;      // this hart has entered scheduler()
+  struct runq rq;
 };
 
 struct kthread_info {
@@ -56,12 +72,24 @@ struct proc {
   uint64 kstack;
   uint64 sz;
   pagetable_t pagetable;
+
+  // resident memory, maintained incrementally by vm.c, bio.c and proc.c
+  uint64 user_pages;    // leaf pages mapped by uvmalloc
+  uint64 pt_pages;      // page-table pages below the root
+  uint64 kstack_pages;
+  uint64 bcache_bufs;   // buffers held between bread and brelse
   struct trapframe *trapframe;
   struct context context;
   struct proc *parent;
   char name[16];
 
   struct kthread_info kthread;
+
+  struct proc *rq_next;   // run queue link, protected by the rq lock
+  int affinity;           // preferred cpu, -1 for none
+
+  struct waitq *wq;       // wait queue p is linked on, or 0; protected by wq->lock
+  struct proc *wq_next;
 };
 
 extern struct proc proc[];
@@ -72,9 +100,13 @@ void sched(void);
 void yield(void);
 void sleep(void *chan, struct spinlock *lk);
 void wakeup(void *chan);
+void wakeup_one(void *chan);
 int kill(int pid);
+int set_affinity(int pid, int cpu);
 struct proc *myproc(void);
+void procdump(void);
 struct cpu *mycpu(void);
+int cpuid(void);
 
 struct proc *alloc_process(void);
 int create_process(const char *name, void (*fn)(void *), void *arg);
@@ -83,11 +115,9 @@ int wait_process(int *status);
 
 int sys_getpid(void);
 int sys_yield(void);
+int sys_sleep(int n);
 int sys_kill(int pid);
 int sys_wait(int *status);
 int sys_exit(int status) __attribute__((noreturn));
 
-void push_off(void);
-void pop_off(void);
-
 void swtch(struct context *old, struct context *new);
@@ -16,6 +16,9 @@
 #define r_time() ({ uint64_t x; asm volatile("csrr %0, time" : "=r"(x)); x; })
 #define r_mcounteren() ({ uint64_t x; asm volatile("csrr %0, mcounteren" : "=r"(x)); x; })
 #define r_menvcfg() ({ uint64_t x; asm volatile("csrr %0, menvcfg" : "=r"(x)); x; })
+/* tp 保存当前 hart 号，由 entry.S 设置 */
+#define r_tp() ({ uint64_t x; asm volatile("mv %0, tp" : "=r"(x)); x; })
+#define r_cycle() ({ uint64_t x; asm volatile("csrr %0, cycle" : "=r"(x)); x; })
 
 #define w_mstatus(x) asm volatile("csrw mstatus, %0" :: "r"(x))
 #define w_mie(x) asm volatile("csrw mie, %0" :: "r"(x))
@@ -111,20 +114,7 @@ typedef uint32 uint;
 typedef uint16 ushort;
 typedef uint8 uchar;
 
-/* 单核版本：简化锁机制 */
-struct spinlock {
-  volatile int locked;
-};
-
-#define initlock(lock, name) ((lock)->locked = 0)
-#define acquire(lock) \
-  do { \
-    while(__sync_lock_test_and_set(&(lock)->locked, 1) != 0) ; \
-  } while(0)
-#define release(lock) (__sync_lock_release(&(lock)->locked))
-static inline int holding(struct spinlock *lk) {
-  return lk->locked != 0;
-}
+#include "spinlock.h"
 
 /* 内存布局符号 */
 extern char end[];  /* 内核结束地址，由链接脚本提供 */
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "spinlock.h"
+
+/*
+ * 睡眠锁：持有期间可以睡眠（例如等待磁盘），等待者让出 CPU 而不是自旋。
+ * 只能在进程上下文中发生等待；启动阶段无竞争时也可直接使用。
+ */
+struct sleeplock {
+  unsigned int locked;   /* 是否被持有 */
+  struct spinlock lk;    /* 保护本结构 */
+  char *name;            /* 调试用 */
+  int pid;               /* 持有者进程，启动阶段为 0 */
+};
+
+void initsleeplock(struct sleeplock *lk, char *name);
+void acquiresleep(struct sleeplock *lk);
+void releasesleep(struct sleeplock *lk);
+int holdingsleep(struct sleeplock *lk);
@@ -0,0 +1,35 @@
+#pragma once
+
+struct cpu;
+
+/* 置 0 可去掉竞争统计 */
+#ifndef LOCK_STATS
+#define LOCK_STATS 1
+#endif
+
+/*
+ * 票号自旋锁：按取号顺序 FIFO 获得锁，等待者只读 owner。
+ * 持有期间关中断，且只能由持有者所在的 CPU 释放。
+ */
+struct spinlock {
+  volatile unsigned int next;    /* 下一个待发放的票号 */
+  volatile unsigned int owner;   /* 当前持有者的票号 */
+  char *name;        /* 调试用 */
+  struct cpu *cpu;   /* 持有锁的 CPU */
+#if LOCK_STATS
+  unsigned long acquires;        /* 获取次数 */
+  unsigned long contended;       /* 需要等待的获取次数 */
+  unsigned long spin_cycles;     /* 等待消耗的总周期数 */
+  struct spinlock *stat_next;    /* 已注册锁链表 */
+  int registered;
+#endif
+};
+
+void initlock(struct spinlock *lk, char *name);
+void acquire(struct spinlock *lk);
+void release(struct spinlock *lk);
+int holding(struct spinlock *lk);
+void push_off(void);
+void pop_off(void);
+void lockstat_dump(void);
+void lockstat_reset(void);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "riscv.h"
+
+/*
+ * 分层时间轮定时器，每个 hart 一个轮，粒度为一个时钟 tick。
+ * 回调在时钟中断中、不持有轮锁时执行，不能睡眠。
+ */
+#define TW_BITS   6
+#define TW_SIZE   (1 << TW_BITS)   /* 每层槽数 */
+#define TW_LEVELS 4                /* 覆盖 2^24 个 tick，更远的截断到最后一层 */
+
+#define TICK_INTERVAL 100000ULL    /* 一个 tick 的 time 周期数 */
+/* 动态 tick 下空闲 hart 最长的睡眠 tick 数：没有 IPI，靠它发现可窃取的工作 */
+#define NOHZ_MAX_TICKS 16
+
+struct timer_base;
+
+struct timer {
+  uint64 expires;             /* 到期 tick（time / TICK_INTERVAL） */
+  uint64 period;              /* 0 为一次性，否则到期后按此间隔重新加入 */
+  void (*fn)(void *arg);
+  void *arg;
+  struct timer *next;
+  struct timer **pprev;       /* 非 0 表示已挂在某个槽上 */
+  struct timer_base *base;
+};
+
+void timerinit(void);
+void timer_setup(struct timer *t, void (*fn)(void *), void *arg);
+void timer_add(struct timer *t, uint64 delay, uint64 period);
+int timer_del(struct timer *t);
+void timer_tick(void);
+uint64 timer_next_expiry(void);
+void timer_sleep(uint64 nticks);
@@ -19,12 +19,15 @@ struct trapframe {
 };
 
 void trap_init(void);
+void trap_inithart(void);
 void timer_init(void);
+void timer_resume_tick(void);
 void register_interrupt(int irq, interrupt_handler_t handler);
 void enable_interrupt(int irq);
 void disable_interrupt(int irq);
 void intr_on(void);
 void intr_off(void);
+int intr_get(void);
 uint64 get_time(void);
 uint64 get_ticks(void);
 void handle_exception(struct trapframe *tf);
@@ -1,11 +1,17 @@
 #include <stdint.h>
 #include "defs.h"
 #include "trap.h"
+#include "proc.h"
 
 extern void main(void);
 
+// 所有 hart 经 entry.S 的 mret 到达这里，tp 已是 hartid
 void start(void){
-  console_init();
-  trap_init();
+  if(cpuid() == 0) {
+    console_init();
+    printfinit();
+    trap_init();
+  }
+  trap_inithart();
   main();
 }
@@ -7,18 +7,31 @@
 #include "fs.h"
 #include "panic.h"
 
+static volatile int started = 0;
+
 void main(void) {
-  uart_puts("\nHello, OS!\n");
-  kinit();
-  kvminit();
-  kvminithart();
-  fileinit();
-  fs_init();
+  if(cpuid() == 0) {
+    uart_puts("\nHello, OS!\n");
+    kinit();
+    kvminit();
+    kvminithart();
+    fileinit();
+    fs_init();
 
-  procinit();
-  timer_init();
-  intr_on();
-  if(create_process("fs-tests", run_fs_tests, 0) < 0)
-    panic("create_process");
-  scheduler();  // 不会返回
+    procinit();
+    timer_init();
+    if(create_process("fs-tests", run_fs_tests, 0) < 0)
+      panic("create_process");
+    __sync_synchronize();
+    started = 1;
+  } else {
+    // 等 hart 0 完成全局初始化
+    while(started == 0)
+      ;
+    __sync_synchronize();
+    kvminithart();
+    timer_init();
+    printf("hart %d starting\n", cpuid());
+  }
+  scheduler();  // 不会返回，scheduler() 中开中断
 }
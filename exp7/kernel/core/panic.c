@@ -2,6 +2,7 @@
 #include "defs.h"
 
 void panic(const char *msg) {
+  printf_disable_lock();
   printf("panic: %s\n", msg);
   for(;;) {
     /* spin */
@@ -7,6 +7,7 @@
 #include "trap.h"
 #include "proc.h"
 #include "fs.h"
+#include "timer.h"
 
 #define TEST_ASSERT(cond, msg)                                      \
   do {                                                              \
@@ -311,12 +312,148 @@ void test_sleep_wakeup_mechanism(void) {
   printf("[PASS] sleep/wakeup\n");
 }
 
+static struct sleeplock test_sleeplock;
+static volatile int sleeplock_entered;
+
+static void sleeplock_task(void *arg) {
+  (void)arg;
+  acquiresleep(&test_sleeplock);
+  sleeplock_entered = 1;
+  TEST_ASSERT(holdingsleep(&test_sleeplock), "sleeplock not held by owner");
+  releasesleep(&test_sleeplock);
+}
+
+void test_sleeplock_blocking(void) {
+  printf("[TEST] sleeplock\n");
+  initsleeplock(&test_sleeplock, "test");
+  sleeplock_entered = 0;
+
+  acquiresleep(&test_sleeplock);
+  TEST_ASSERT(holdingsleep(&test_sleeplock), "sleeplock not held");
+  int pid = create_process("sleeplock", sleeplock_task, 0);
+  TEST_ASSERT(pid > 0, "create_process failed");
+  for(int i = 0; i < 8; i++)
+    sys_yield();
+  TEST_ASSERT(sleeplock_entered == 0, "waiter entered a held sleeplock");
+  releasesleep(&test_sleeplock);
+  TEST_ASSERT(!holdingsleep(&test_sleeplock), "sleeplock still held");
+
+  int status = -1;
+  TEST_ASSERT(wait_process(&status) == pid, "wait_process returned unexpected pid");
+  TEST_ASSERT(status == 0, "child exit status non-zero");
+  TEST_ASSERT(sleeplock_entered == 1, "waiter never acquired the sleeplock");
+  printf("[PASS] sleeplock\n");
+}
+
+static volatile int periodic_hits;
+static volatile int wake_order[3];
+static volatile int wake_idx;
+
+static void periodic_fn(void *arg) {
+  (void)arg;
+  __atomic_fetch_add(&periodic_hits, 1, __ATOMIC_RELAXED);
+}
+
+static void timed_sleeper(void *arg) {
+  int n = (int)(uint64)arg;
+  TEST_ASSERT(sys_sleep(n) == 0, "sleep interrupted");
+  wake_order[__atomic_fetch_add(&wake_idx, 1, __ATOMIC_RELAXED)] = n;
+}
+
+void test_timer_wheel(void) {
+  printf("[TEST] timer wheel\n");
+  static const int delays[3] = { 100, 5, 40 };  // 100 crosses into level 1
+  wake_idx = 0;
+  for(int i = 0; i < 3; i++)
+    TEST_ASSERT(create_process("timed", timed_sleeper, (void *)(uint64)delays[i]) > 0,
+                "create_process failed");
+
+  struct timer pt;
+  periodic_hits = 0;
+  timer_setup(&pt, periodic_fn, 0);
+  timer_add(&pt, 2, 2);
+  uint64 before = get_ticks();
+  TEST_ASSERT(sys_sleep(20) == 0, "sleep interrupted");
+  TEST_ASSERT(get_ticks() - before >= 19, "woke up early");
+  TEST_ASSERT(timer_del(&pt) == 1, "periodic timer not pending");
+  TEST_ASSERT(periodic_hits >= 8 && periodic_hits <= 11, "periodic timer count off");
+
+  int status;
+  for(int i = 0; i < 3; i++) {
+    TEST_ASSERT(wait_process(&status) > 0, "wait_process failed");
+    TEST_ASSERT(status == 0, "child exit status non-zero");
+  }
+  TEST_ASSERT(wake_order[0] == 5 && wake_order[1] == 40 && wake_order[2] == 100,
+              "sleepers woke out of order");
+  printf("[PASS] timer wheel\n");
+}
+
+static volatile int affinity_cpu;
+
+static void affinity_task(void *arg) {
+  (void)arg;
+  struct proc *p = myproc();
+  TEST_ASSERT(set_affinity(p->pid, 0) == 0, "set_affinity failed");
+  // the hint applies from the next enqueue on
+  sys_yield();
+  push_off();
+  affinity_cpu = cpuid();
+  pop_off();
+}
+
+void test_scheduler_affinity(void) {
+  printf("[TEST] scheduler affinity\n");
+  affinity_cpu = -1;
+  TEST_ASSERT(set_affinity(-1, NCPU) < 0, "bad cpu accepted");
+  int pid = create_process("affinity", affinity_task, 0);
+  TEST_ASSERT(pid > 0, "create_process failed");
+  int status = -1;
+  TEST_ASSERT(wait_process(&status) == pid, "wait_process returned unexpected pid");
+  TEST_ASSERT(affinity_cpu == 0, "task did not run on its preferred cpu");
+  printf("[PASS] scheduler affinity\n");
+}
+
+static void memstat_task(void *arg) {
+  (void)arg;
+  struct proc *p = myproc();
+  TEST_ASSERT(p->kstack_pages == 1, "kstack not charged");
+
+  p->pagetable = uvmcreate();
+  TEST_ASSERT(p->pagetable != 0, "uvmcreate failed");
+  p->sz = uvmalloc(p->pagetable, 0, 3*PGSIZE, PTE_W);
+  TEST_ASSERT(p->sz == 3*PGSIZE, "uvmalloc failed");
+  TEST_ASSERT(p->user_pages == 3, "user pages not charged");
+  TEST_ASSERT(p->pt_pages == 2, "page-table pages not charged");
+
+  p->sz = uvmdealloc(p->pagetable, p->sz, PGSIZE);
+  TEST_ASSERT(p->user_pages == 1, "user pages not released");
+
+  uvmfree(p->pagetable, p->sz);
+  p->pagetable = 0;
+  p->sz = 0;
+  TEST_ASSERT(p->user_pages == 0 && p->pt_pages == 0, "counters not cleared");
+}
+
+void test_process_memstat(void) {
+  printf("[TEST] per-process memory accounting\n");
+  int pid = create_process("memstat", memstat_task, 0);
+  TEST_ASSERT(pid > 0, "create_process failed");
+  int status = -1;
+  TEST_ASSERT(wait_process(&status) == pid, "wait_process returned unexpected pid");
+  TEST_ASSERT(status == 0, "child exit status non-zero");
+  printf("[PASS] per-process memory accounting\n");
+}
+
 void run_proc_tests(void *arg) {
   (void)arg;
   printf("[SUITE] running kernel tests\n");
   test_process_creation_basic();
   test_scheduler_round_robin();
   test_sleep_wakeup_mechanism();
+  test_sleeplock_blocking();
+  test_timer_wheel();
+  test_scheduler_affinity();
+  test_process_memstat();
   printf("[SUITE] all tests finished\n");
 }
 
@@ -453,6 +590,12 @@ void test_filesystem_performance(void) {
   TEST_ASSERT(fs_write_file("/large_file", fs_large_buffer, sizeof(fs_large_buffer)) ==
               (int)sizeof(fs_large_buffer), "perf large write failed");
   uint64 large_time = get_time() - start;
+  // larger than one transaction: the tail must have made it too
+  memset(fs_large_buffer, 0, sizeof(fs_large_buffer));
+  TEST_ASSERT(fs_read_file("/large_file", fs_large_buffer, sizeof(fs_large_buffer)) ==
+              (int)sizeof(fs_large_buffer), "perf large read back failed");
+  TEST_ASSERT((uchar)fs_large_buffer[sizeof(fs_large_buffer) - 1] == 0xcd,
+              "perf large write lost its tail");
   TEST_ASSERT(fs_delete_file("/large_file") == 0, "perf large delete failed");
 
   printf("[INFO] small files (%d x %dB): %d cycles\n",
@@ -507,5 +650,6 @@ void run_fs_tests(void *arg) {
   debug_filesystem_state();
   debug_inode_usage();
   debug_disk_io();
+  lockstat_dump();
   printf("[SUITE] filesystem tests finished\n");
 }
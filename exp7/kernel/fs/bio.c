@@ -2,15 +2,24 @@
 #include "defs.h"
 #include "string.h"
 #include "panic.h"
+#include "proc.h"
 
-struct {
+// buffers hashed by (dev, blockno). each bucket has its own lock and
+// LRU list (head.next is most recently used); a miss that finds no free
+// buffer in its bucket steals the least recently used one elsewhere.
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
   struct buf head;
+  uint hits;
+  uint misses;
+};
+
+struct {
+  struct spinlock steal_lock;  // serializes cross-bucket steals
+  struct buf buf[NBUF];
+  struct bucket bucket[NBUCKET];
 } bcache;
 
-static uint buffer_cache_hits;
-static uint buffer_cache_misses;
 static uint disk_read_count;
 static uint disk_write_count;
 
@@ -26,9 +35,9 @@ ramdisk_rw(struct buf *b, int write) {
   if(b->blockno >= FSSIZE)
     panic("ramdisk out of bounds");
   if(write)
-    disk_write_count++;
+    __atomic_fetch_add(&disk_write_count, 1, __ATOMIC_RELAXED);
   else
-    disk_read_count++;
+    __atomic_fetch_add(&disk_read_count, 1, __ATOMIC_RELAXED);
   if(write) {
     memmove(ramdisk[b->blockno], b->data, BSIZE);
   } else {
@@ -36,52 +45,125 @@ ramdisk_rw(struct buf *b, int write) {
   }
 }
 
+static struct bucket*
+bucket_of(uint dev, uint blockno) {
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
+static void
+lru_remove(struct buf *b) {
+  b->next->prev = b->prev;
+  b->prev->next = b->next;
+}
+
+static void
+lru_push_front(struct bucket *bk, struct buf *b) {
+  b->next = bk->head.next;
+  b->prev = &bk->head;
+  bk->head.next->prev = b;
+  bk->head.next = b;
+}
+
 void
 binit(void) {
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  initlock(&bcache.steal_lock, "bcache.steal");
   ramdisk_init();
 
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
+  for(int i = 0; i < NBUCKET; i++) {
+    struct bucket *bk = &bcache.bucket[i];
+    initlock(&bk->lock, "bcache.bucket");
+    bk->head.prev = &bk->head;
+    bk->head.next = &bk->head;
+  }
+  // spread the free buffers over all buckets
   for(b = bcache.buf; b < bcache.buf + NBUF; b++) {
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-    initlock(&b->lock, "buf");
+    initsleeplock(&b->lock, "buffer");
+    lru_push_front(&bcache.bucket[(b - bcache.buf) % NBUCKET], b);
   }
 }
 
+static struct buf*
+bucket_lookup(struct bucket *bk, uint dev, uint blockno) {
+  for(struct buf *b = bk->head.next; b != &bk->head; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// least recently used unreferenced buffer in bk, or 0
+static struct buf*
+bucket_victim(struct bucket *bk) {
+  for(struct buf *b = bk->head.prev; b != &bk->head; b = b->prev)
+    if(b->refcnt == 0)
+      return b;
+  return 0;
+}
+
+static void
+bclaim(struct buf *b, uint dev, uint blockno) {
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->disk = 0;
+  b->refcnt = 1;
+}
+
 static struct buf*
 bget(uint dev, uint blockno) {
+  struct bucket *bk = bucket_of(dev, blockno);
   struct buf *b;
 
-  acquire(&bcache.lock);
-
-  for(b = bcache.head.next; b != &bcache.head; b = b->next) {
-    if(b->dev == dev && b->blockno == blockno) {
-      buffer_cache_hits++;
-      b->refcnt++;
-      release(&bcache.lock);
-      acquire(&b->lock);
-      return b;
-    }
+  acquire(&bk->lock);
+  if((b = bucket_lookup(bk, dev, blockno)) != 0) {
+    bk->hits++;
+    b->refcnt++;
+    release(&bk->lock);
+    acquiresleep(&b->lock);
+    return b;
   }
 
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev) {
-    if(b->refcnt == 0) {
-      buffer_cache_misses++;
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->disk = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquire(&b->lock);
+  bk->misses++;
+  if((b = bucket_victim(bk)) != 0) {
+    bclaim(b, dev, blockno);
+    release(&bk->lock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  release(&bk->lock);
+
+  // steal from another bucket. only one stealer at a time may hold two
+  // bucket locks, so ordinary single-bucket holders cannot deadlock it.
+  acquire(&bcache.steal_lock);
+  acquire(&bk->lock);
+  // someone may have brought the block in, or freed a buffer here,
+  // while we held no lock
+  if((b = bucket_lookup(bk, dev, blockno)) != 0)
+    b->refcnt++;
+  else if((b = bucket_victim(bk)) != 0)
+    bclaim(b, dev, blockno);
+  if(b) {
+    release(&bk->lock);
+    release(&bcache.steal_lock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  for(int i = 1; i < NBUCKET; i++) {
+    struct bucket *victim = &bcache.bucket[(bk - bcache.bucket + i) % NBUCKET];
+    acquire(&victim->lock);
+    b = bucket_victim(victim);
+    if(b) {
+      lru_remove(b);
+      release(&victim->lock);
+      bclaim(b, dev, blockno);
+      lru_push_front(bk, b);
+      release(&bk->lock);
+      release(&bcache.steal_lock);
+      acquiresleep(&b->lock);
       return b;
     }
+    release(&victim->lock);
   }
 
   panic("bget: no buffers");
@@ -91,62 +173,74 @@ bget(uint dev, uint blockno) {
 struct buf*
 bread(uint dev, uint blockno) {
   struct buf *b = bget(dev, blockno);
+  struct proc *p = myproc();
   if(!b->valid) {
     ramdisk_rw(b, 0);
     b->valid = 1;
   }
+  if(p)
+    p->bcache_bufs++;
   return b;
 }
 
 void
 bwrite(struct buf *b) {
-  if(!holding(&b->lock))
+  if(!holdingsleep(&b->lock))
     panic("bwrite");
   ramdisk_rw(b, 1);
 }
 
 void
 brelse(struct buf *b) {
-  if(!holding(&b->lock))
+  if(!holdingsleep(&b->lock))
     panic("brelse");
 
-  release(&b->lock);
+  releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  struct proc *p = myproc();
+  if(p && p->bcache_bufs > 0)
+    p->bcache_bufs--;
+
+  // dev/blockno cannot change while refcnt > 0, so the bucket is stable
+  struct bucket *bk = bucket_of(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt--;
   if(b->refcnt == 0) {
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    lru_remove(b);
+    lru_push_front(bk, b);
   }
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bucket_of(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bucket_of(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 fs_get_cache_counters(struct fs_cache_counters *counters) {
   if(counters == 0)
     return;
-  acquire(&bcache.lock);
-  counters->buffer_cache_hits = buffer_cache_hits;
-  counters->buffer_cache_misses = buffer_cache_misses;
-  counters->disk_read_count = disk_read_count;
-  counters->disk_write_count = disk_write_count;
-  release(&bcache.lock);
+  counters->buffer_cache_hits = 0;
+  counters->buffer_cache_misses = 0;
+  for(int i = 0; i < NBUCKET; i++) {
+    struct bucket *bk = &bcache.bucket[i];
+    acquire(&bk->lock);
+    counters->buffer_cache_hits += bk->hits;
+    counters->buffer_cache_misses += bk->misses;
+    release(&bk->lock);
+  }
+  counters->disk_read_count = __atomic_load_n(&disk_read_count, __ATOMIC_RELAXED);
+  counters->disk_write_count = __atomic_load_n(&disk_write_count, __ATOMIC_RELAXED);
 }
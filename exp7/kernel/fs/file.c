@@ -2,6 +2,8 @@
 #include "defs.h"
 #include "panic.h"
 
+#define FILEWRITE_OVERHEAD 4   /* non-data blocks logged per filewrite transaction */
+
 struct {
   struct spinlock lock;
   struct file file[NFILE];
@@ -78,19 +80,20 @@ filewrite(struct file *f, char *addr, int n) {
   if(f->writable == 0)
     return -1;
   if(f->type == FD_INODE) {
-    int max = MAXOPBLOCKS * BSIZE;
+    // size each transaction to the free log space; the non-data blocks
+    // are the inode, indirect block, bitmap and one for an unaligned start
     int i = 0;
     while(i < n) {
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-      begin_op();
+      int granted = begin_op_n((n - i + BSIZE - 1) / BSIZE + FILEWRITE_OVERHEAD);
+      int n1 = (granted - FILEWRITE_OVERHEAD) * BSIZE;
+      if(n1 > n - i)
+        n1 = n - i;
       ilock(f->ip);
       int r = writei(f->ip, (uint64)addr + i, f->off, n1);
       if(r > 0)
         f->off += r;
       iunlock(f->ip);
-      end_op();
+      end_op_n(granted);
       if(r < 0)
         break;
       if(r != n1)
@@ -91,7 +91,7 @@ iinit(void) {
   initlock(&icache.lock, "icache");
   for(int i = 0; i < NINODE; i++) {
     struct inode *ip = &icache.inode[i];
-    initlock(&ip->lock, "inode");
+    initsleeplock(&ip->lock, "inode");
     ip->ref = 0;
     ip->valid = 0;
   }
@@ -135,7 +135,7 @@ ilock(struct inode *ip) {
   if(ip == 0 || ip->ref < 1)
     panic("ilock");
 
-  acquire(&ip->lock);
+  acquiresleep(&ip->lock);
   if(ip->valid == 0) {
     struct buf *bp = bread(ip->dev, IBLOCK(ip->inum, sb));
     struct dinode *dip = (struct dinode*)bp->data + (ip->inum % IPB);
@@ -154,9 +154,9 @@ ilock(struct inode *ip) {
 
 void
 iunlock(struct inode *ip) {
-  if(ip == 0 || !holding(&ip->lock))
+  if(ip == 0 || !holdingsleep(&ip->lock))
     panic("iunlock");
-  release(&ip->lock);
+  releasesleep(&ip->lock);
 }
 
 void
@@ -177,13 +177,13 @@ void
 iput(struct inode *ip) {
   acquire(&icache.lock);
   if(ip->ref == 1 && ip->valid && ip->nlink == 0) {
-    acquire(&ip->lock);
+    acquiresleep(&ip->lock);
     release(&icache.lock);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
     ip->valid = 0;
-    release(&ip->lock);
+    releasesleep(&ip->lock);
     acquire(&icache.lock);
   }
   ip->ref--;
@@ -537,16 +537,34 @@ create(const char *path, short type, short major, short minor) {
 
 int
 fs_write_file(const char *path, const char *data, int len) {
-  begin_op();
+  // every transaction logs the inode, indirect and a bitmap block; the
+  // first also the parent directory's inode and entry block touched by
+  // create(). The log may grant less than asked for, so the data goes
+  // in as many transactions as it takes.
+  int extra = 5;
+  int granted = begin_op_n((len + BSIZE - 1) / BSIZE + extra);
   struct inode *ip = create(path, T_FILE, 0, 0);
   if(ip == 0) {
-    end_op();
+    end_op_n(granted);
     return -1;
   }
-  int wrote = writei(ip, (uint64)data, 0, len);
+  int off = 0, r;
+  for(;;) {
+    int n = MIN(len - off, (granted - extra) * BSIZE);
+    r = writei(ip, (uint64)data + off, off, n);
+    if(r > 0)
+      off += r;
+    if(r != n || off >= len)
+      break;
+    iunlock(ip);
+    end_op_n(granted);
+    extra = 3;
+    granted = begin_op_n((len - off + BSIZE - 1) / BSIZE + extra);
+    ilock(ip);
+  }
   iunlockput(ip);
-  end_op();
-  return wrote;
+  end_op_n(granted);
+  return r < 0 && off == 0 ? -1 : off;
 }
 
 int
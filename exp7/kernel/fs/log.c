@@ -2,6 +2,7 @@
 #include "defs.h"
 #include "string.h"
 #include "panic.h"
+#include "proc.h"
 
 struct {
   struct spinlock lock;
@@ -9,6 +10,7 @@ struct {
   int start;
   int size;
   int outstanding;
+  int reserved;     // log blocks reserved by outstanding ops
   int committing;
 
   struct logheader {
@@ -27,39 +29,61 @@ log_init(int dev, struct superblock *sb) {
   logstate.dev = dev;
   logstate.start = sb->logstart;
   logstate.size = sb->nlog;
+  if(logstate.size > LOGSIZE)
+    logstate.size = LOGSIZE;
   recover_from_log();
 }
 
-void
-begin_op(void) {
+// the first log block holds the header
+static int
+log_capacity(void) {
+  return logstate.size - 1;
+}
+
+// Reserve up to want log blocks for one operation. Waits until at least
+// min(want, MAXOPBLOCKS) are free, then grants as many as it can. The
+// caller must not log more blocks than granted and hands the same count
+// back to end_op_n().
+int
+begin_op_n(int want) {
+  int need = want < MAXOPBLOCKS ? want : MAXOPBLOCKS;
+
   acquire(&logstate.lock);
   while(1) {
-    if(logstate.committing) {
-      release(&logstate.lock);
-      continue;
-    }
-    if(logstate.lh.n + (logstate.outstanding + 1) * MAXOPBLOCKS > LOGSIZE) {
-      release(&logstate.lock);
-      continue;
+    int avail = log_capacity() - logstate.lh.n - logstate.reserved;
+    if(logstate.committing || avail < need) {
+      // 提交中或日志空间不足，等待
+      sleep(&logstate, &logstate.lock);
     } else {
+      int granted = want < avail ? want : avail;
+      logstate.reserved += granted;
       logstate.outstanding += 1;
       release(&logstate.lock);
-      break;
+      return granted;
     }
   }
 }
 
 void
-end_op(void) {
+begin_op(void) {
+  begin_op_n(MAXOPBLOCKS);
+}
+
+void
+end_op_n(int granted) {
   int do_commit = 0;
 
   acquire(&logstate.lock);
   logstate.outstanding -= 1;
+  logstate.reserved -= granted;
   if(logstate.committing)
     panic("log committing");
   if(logstate.outstanding == 0) {
     do_commit = 1;
     logstate.committing = 1;
+  } else {
+    // begin_op_n() 可能在等待日志空间，预留减少后唤醒它
+    wakeup(&logstate);
   }
   release(&logstate.lock);
 
@@ -70,13 +94,19 @@ end_op(void) {
     logstate.lh.n = 0;
     write_log();
     logstate.committing = 0;
+    wakeup(&logstate);
     release(&logstate.lock);
   }
 }
 
+void
+end_op(void) {
+  end_op_n(MAXOPBLOCKS);
+}
+
 void
 log_write(struct buf *b) {
-  if(logstate.lh.n >= LOGSIZE)
+  if(logstate.lh.n >= log_capacity())
     panic("log_write: too big");
   if(logstate.outstanding < 1)
     panic("log_write outside transaction");
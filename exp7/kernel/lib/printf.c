@@ -1,6 +1,21 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include "defs.h"
+#include "spinlock.h"
+
+// 多个 hart 同时打印时保证整行不交错
+static struct spinlock pr_lock;
+static volatile int pr_locking;
+
+void printfinit(void) {
+  initlock(&pr_lock, "pr");
+  pr_locking = 1;
+}
+
+// panic 时可能已持有 pr_lock，之后的输出不再加锁
+void printf_disable_lock(void) {
+  pr_locking = 0;
+}
 
 static void print_number(long long x, int base, int sign) {
   char buf[32];
@@ -34,6 +49,9 @@ void printfint(int x) {
 
 int printf(const char *fmt, ...) {
   va_list ap;
+  int locking = pr_locking;
+  if(locking)
+    acquire(&pr_lock);
   va_start(ap, fmt);
   int cnt = 0;
   for (; *fmt; fmt++) {
@@ -103,6 +121,8 @@ int printf(const char *fmt, ...) {
     }
   }
   va_end(ap);
+  if(locking)
+    release(&pr_lock);
   return cnt;
 }
 
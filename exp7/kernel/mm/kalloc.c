@@ -2,18 +2,19 @@
 #include "kalloc.h"
 #include "panic.h"
 #include "string.h"
-
-/* 简化版本：单核不需要真正的锁 */
+#include "spinlock.h"
 
 struct run {
   struct run *next;
 };
 
 struct {
+  struct spinlock lock;
   struct run *freelist;
 } kmem;
 
 void kinit() {
+  initlock(&kmem.lock, "kmem");
   freerange((void*)end, (void*)PHYSTOP);
 }
 
@@ -33,18 +34,24 @@ void kfree(void *pa) {
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
+
+  acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  release(&kmem.lock);
 }
 
 void *kalloc(void) {
   struct run *r;
 
+  acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r) {
+  if(r)
     kmem.freelist = r->next;
+  release(&kmem.lock);
+
+  if(r)
     memset((char*)r, 5, PGSIZE);
-  }
-  
+
   return (void*)r;
 }
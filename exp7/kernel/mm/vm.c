@@ -3,6 +3,7 @@
 #include "panic.h"
 #include "string.h"
 #include "vm.h"
+#include "proc.h"
 
 extern char end[]; // first address after kernel
 
@@ -10,7 +11,7 @@ pagetable_t kernel_pagetable;
 
 static void kvmmap(uint64 va, uint64 pa, uint64 sz, int perm);
 static int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm);
-static void freewalk(pagetable_t pagetable);
+static void freewalk(pagetable_t pagetable, struct proc *owner);
 uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz);
 void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free);
 
@@ -46,12 +47,23 @@ static void kvmmap(uint64 va, uint64 pa, uint64 sz, int perm) {
     panic("kvmmap");
 }
 
+// the process whose private page table this is, if any;
+// page-table and user-page counts are charged to it.
+static struct proc *vm_owner(pagetable_t pagetable) {
+  struct proc *p = myproc();
+  if(p && p->pagetable == pagetable)
+    return p;
+  return 0;
+}
+
 void kvminithart(void) {
   w_satp(MAKE_SATP(kernel_pagetable));
   sfence_vma();
 }
 
 pte_t *walk(pagetable_t pagetable, uint64 va, int alloc) {
+  struct proc *owner = alloc ? vm_owner(pagetable) : 0;
+
   if(va >= MAXVA)
     panic("walk");
 
@@ -67,6 +79,8 @@ pte_t *walk(pagetable_t pagetable, uint64 va, int alloc) {
         return 0;
       memset(next, 0, PGSIZE);
       *pte = PA2PTE(next) | PTE_V;
+      if(owner)
+        owner->pt_pages++;
       pagetable = next;
     }
   }
@@ -108,12 +122,13 @@ pagetable_t uvmcreate(void) {
 void uvmfree(pagetable_t pagetable, uint64 sz) {
   if(sz > 0)
     uvmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1);
-  freewalk(pagetable);
+  freewalk(pagetable, vm_owner(pagetable));
 }
 
 void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free) {
   uint64 a;
   pte_t *pte;
+  struct proc *owner = do_free ? vm_owner(pagetable) : 0;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
@@ -128,18 +143,22 @@ void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free) {
     if(do_free){
       uint64 pa = PTE2PA(*pte);
       kfree((void*)pa);
+      if(owner && owner->user_pages > 0)
+        owner->user_pages--;
     }
     *pte = 0;
   }
 }
 
-static void freewalk(pagetable_t pagetable) {
+static void freewalk(pagetable_t pagetable, struct proc *owner) {
   for(int i = 0; i < 512; i++) {
     pte_t pte = pagetable[i];
     if((pte & PTE_V) && (pte & (PTE_R | PTE_W | PTE_X)) == 0) {
       uint64 child = PTE2PA(pte);
-      freewalk((pagetable_t)child);
+      freewalk((pagetable_t)child, owner);
       pagetable[i] = 0;
+      if(owner && owner->pt_pages > 0)
+        owner->pt_pages--;
     } else if(pte & PTE_V) {
       panic("freewalk: leaf");
     }
@@ -162,6 +181,7 @@ uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz) {
 uint64 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm) {
   char *mem;
   uint64 a;
+  struct proc *owner = vm_owner(pagetable);
 
   if(newsz < oldsz)
     return oldsz;
@@ -179,6 +199,8 @@ uint64 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm) {
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
+    if(owner)
+      owner->user_pages++;
   }
   return newsz;
 }
@@ -13,12 +13,15 @@ static struct spinlock pid_lock;
 static struct spinlock wait_lock;
 struct cpu cpus[NCPU];
 
+#define NWAITQ 64
+static struct waitq waitqs[NWAITQ];
+
 static int nextpid = 1;
 
 static void proc_entry(void) __attribute__((noreturn));
 static void freeproc(struct proc *p);
 static int allocpid(void);
-static int intr_get(void);
+static void make_runnable(struct proc *p);
 
 void
 procinit(void) {
@@ -29,46 +32,54 @@ procinit(void) {
     initlock(&p->lock, "proc");
     p->state = UNUSED;
     p->kstack = 0;
+    p->affinity = -1;
+  }
+  for(int i = 0; i < NCPU; i++)
+    initlock(&cpus[i].rq.lock, "runq");
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitqs[i].lock, "waitq");
+}
+
+static struct waitq*
+waitq_of(void *chan) {
+  uint64 a = (uint64)chan;
+  return &waitqs[((a >> 3) ^ (a >> 12)) % NWAITQ];
+}
+
+// caller holds wq->lock.
+static void
+waitq_remove(struct waitq *wq, struct proc *p) {
+  struct proc **pp = &wq->head;
+  while(*pp) {
+    if(*pp == p) {
+      *pp = p->wq_next;
+      break;
+    }
+    pp = &(*pp)->wq_next;
   }
+  p->wq_next = 0;
+  p->wq = 0;
 }
 
 static int
 allocpid(void) {
   int pid;
 
-  push_off();
+  acquire(&pid_lock);
   pid = nextpid++;
-  pop_off();
+  release(&pid_lock);
   return pid;
 }
 
-struct cpu*
-mycpu(void) {
-  return &cpus[0];
-}
-
-static int
-intr_get(void) {
-  return (r_sstatus() & SSTATUS_SIE) != 0;
-}
-
-void
-push_off(void) {
-  int old = intr_get();
-  intr_off();
-  struct cpu *c = mycpu();
-  if(c->noff++ == 0)
-    c->intena = old;
+// 必须在关中断时调用，防止读取 tp 后被迁移到其他 CPU
+int
+cpuid(void) {
+  return (int)r_tp();
 }
 
-void
-pop_off(void) {
-  struct cpu *c = mycpu();
-  if(c->noff <= 0)
-    panic("pop_off");
-  c->noff--;
-  if(c->noff == 0 && c->intena)
-    intr_on();
+struct cpu*
+mycpu(void) {
+  return &cpus[cpuid()];
 }
 
 struct proc*
@@ -94,6 +105,10 @@ freeproc(struct proc *p) {
     kfree((void*)p->kstack);
     p->kstack = 0;
   }
+  p->user_pages = 0;
+  p->pt_pages = 0;
+  p->kstack_pages = 0;
+  p->bcache_bufs = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
@@ -103,6 +118,8 @@ freeproc(struct proc *p) {
   p->state = UNUSED;
   p->kthread.start = 0;
   p->kthread.arg = 0;
+  p->rq_next = 0;
+  p->affinity = -1;
   memset(&p->context, 0, sizeof(p->context));
 }
 
@@ -129,6 +146,7 @@ alloc_process(void) {
           return 0;
         }
       }
+      p->kstack_pages = KSTACK_SIZE / PGSIZE;
 
       p->trapframe = (struct trapframe*)kalloc();
       if(p->trapframe == 0) {
@@ -180,7 +198,7 @@ create_process(const char *name, void (*fn)(void *), void *arg) {
   p->kthread.start = fn;
   p->kthread.arg = arg;
   p->parent = myproc();
-  p->state = RUNNABLE;
+  make_runnable(p);
   release(&p->lock);
   return p->pid;
 }
@@ -253,6 +271,14 @@ sched(void) {
 
   if(p == 0)
     panic("sched no proc");
+  if(!holding(&p->lock))
+    panic("sched p->lock");
+  if(c->noff != 1)
+    panic("sched locks");
+  if(p->state == RUNNING)
+    panic("sched running");
+  if(intr_get())
+    panic("sched interruptible");
 
   int intena = c->intena;
   swtch(&p->context, &c->context);
@@ -265,7 +291,7 @@ yield(void) {
   if(p == 0)
     return;
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  make_runnable(p);
   sched();
   release(&p->lock);
 }
@@ -279,16 +305,30 @@ sleep(void *chan, struct spinlock *lk) {
   if(lk == 0)
     panic("sleep without lk");
 
-  if(lk != &p->lock) {
+  // link onto the wait queue before dropping lk, so a wakeup()
+  // issued right after release(lk) finds us. the waker then blocks
+  // on p->lock until we are off this cpu.
+  struct waitq *wq = waitq_of(chan);
+  if(lk != &p->lock)
     acquire(&p->lock);
+  p->chan = chan;
+  acquire(&wq->lock);
+  p->wq = wq;
+  p->wq_next = wq->head;
+  wq->head = p;
+  release(&wq->lock);
+  if(lk != &p->lock)
     release(lk);
-  }
 
-  p->chan = chan;
   p->state = SLEEPING;
 
   sched();
 
+  // woken by kill() or a lost race: we may still be linked
+  acquire(&wq->lock);
+  if(p->wq)
+    waitq_remove(wq, p);
+  release(&wq->lock);
   p->chan = 0;
 
   if(lk != &p->lock) {
@@ -297,18 +337,65 @@ sleep(void *chan, struct spinlock *lk) {
   }
 }
 
-void
-wakeup(void *chan) {
-  for(int i = 0; i < NPROC; i++) {
-    struct proc *p = &proc[i];
-    if(p == myproc())
+// wake up to max sleepers on chan (0 = all); returns the number woken.
+// matches are unlinked under the bucket lock into a local array, and
+// each p->lock is taken only after the bucket lock is dropped, so the
+// order p->lock -> wq->lock used by sleep() is never inverted.
+static int
+wakeup_n(void *chan, int max) {
+  struct proc *batch[NPROC];
+  struct waitq *wq = waitq_of(chan);
+  struct proc *me = myproc();
+  int n = 0, woken = 0;
+
+  acquire(&wq->lock);
+  struct proc **pp = &wq->head;
+  while(*pp && (max == 0 || n < max)) {
+    struct proc *p = *pp;
+    if(p == me || p->chan != chan) {
+      pp = &p->wq_next;
       continue;
+    }
+    *pp = p->wq_next;
+    p->wq_next = 0;
+    p->wq = 0;
+    batch[n++] = p;
+  }
+  release(&wq->lock);
+
+  for(int i = 0; i < n; i++) {
+    struct proc *p = batch[i];
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
-      p->state = RUNNABLE;
+      make_runnable(p);
+      woken++;
     }
     release(&p->lock);
   }
+  return woken;
+}
+
+void
+wakeup(void *chan) {
+  wakeup_n(chan, 0);
+}
+
+// wake a single sleeper, for producer/consumer style hand-offs where
+// waking everyone would only send the rest back to sleep.
+void
+wakeup_one(void *chan) {
+  // a candidate already woken by kill() does not count; try the next
+  while(wakeup_n(chan, 1) == 0) {
+    struct waitq *wq = waitq_of(chan);
+    int more = 0;
+    acquire(&wq->lock);
+    for(struct proc *p = wq->head; p; p = p->wq_next)
+      if(p->chan == chan)
+        more = 1;
+    release(&wq->lock);
+    if(!more)
+      break;
+  }
 }
 
 int
@@ -319,7 +406,118 @@ kill(int pid) {
     if(p->pid == pid && (p->state == SLEEPING || p->state == RUNNABLE || p->state == RUNNING || p->state == USED)) {
       p->killed = 1;
       if(p->state == SLEEPING)
-        p->state = RUNNABLE;
+        make_runnable(p);
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// append a chain of n processes linked through rq_next.
+static void
+rq_append(struct runq *rq, struct proc *first, struct proc *last, int n) {
+  last->rq_next = 0;
+  if(rq->tail)
+    rq->tail->rq_next = first;
+  else
+    rq->head = first;
+  rq->tail = last;
+  rq->len += n;
+}
+
+// mark p RUNNABLE and queue it on its affinity cpu, or else locally.
+// caller holds p->lock, so interrupts are off and cpuid() is stable.
+static void
+make_runnable(struct proc *p) {
+  int cpu = p->affinity;
+  if(cpu < 0 || cpu >= NCPU || !cpus[cpu].started)
+    cpu = cpuid();
+
+  p->state = RUNNABLE;
+  struct runq *rq = &cpus[cpu].rq;
+  acquire(&rq->lock);
+  rq_append(rq, p, p, 1);
+  release(&rq->lock);
+  // work now competes here: bring the periodic tick back on this hart.
+  // other harts notice within NOHZ_MAX_TICKS (no IPIs available).
+  if(cpu == cpuid() && mycpu()->proc)
+    timer_resume_tick();
+}
+
+static struct proc*
+rq_pop(struct runq *rq) {
+  acquire(&rq->lock);
+  struct proc *p = rq->head;
+  if(p) {
+    rq->head = p->rq_next;
+    if(rq->head == 0)
+      rq->tail = 0;
+    rq->len--;
+    p->rq_next = 0;
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// take about half of victim's queue, leaving processes that prefer
+// the victim cpu in place. only one rq lock is held at a time: the
+// stolen chain is detached under the victim's lock and appended to
+// our own queue afterwards.
+static int
+rq_steal(struct cpu *c, int victim) {
+  struct runq *vrq = &cpus[victim].rq;
+  struct proc *first = 0, *last = 0;
+  int n = 0;
+
+  acquire(&vrq->lock);
+  int want = (vrq->len + 1) / 2;
+  struct proc *prev = 0;
+  struct proc *p = vrq->head;
+  while(p && n < want) {
+    struct proc *next = p->rq_next;
+    if(p->affinity == victim) {
+      prev = p;
+    } else {
+      if(prev)
+        prev->rq_next = next;
+      else
+        vrq->head = next;
+      if(vrq->tail == p)
+        vrq->tail = prev;
+      vrq->len--;
+      p->rq_next = 0;
+      if(last)
+        last->rq_next = p;
+      else
+        first = p;
+      last = p;
+      n++;
+    }
+    p = next;
+  }
+  release(&vrq->lock);
+
+  if(n > 0) {
+    acquire(&c->rq.lock);
+    rq_append(&c->rq, first, last, n);
+    release(&c->rq.lock);
+  }
+  return n;
+}
+
+// hint that pid should run on cpu; -1 clears the hint.
+// takes effect the next time the process becomes RUNNABLE.
+int
+set_affinity(int pid, int cpu) {
+  if(cpu < -1 || cpu >= NCPU || (cpu >= 0 && !cpus[cpu].started))
+    return -1;
+  for(int i = 0; i < NPROC; i++) {
+    struct proc *p = &proc[i];
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED) {
+      p->affinity = cpu;
       release(&p->lock);
       return 0;
     }
@@ -331,19 +529,60 @@ kill(int pid) {
 void
 scheduler(void) {
   struct cpu *c = mycpu();
+  int me = cpuid();
   c->proc = 0;
+  c->started = 1;
   for(;;) {
     intr_on();
-    for(int i = 0; i < NPROC; i++) {
-      struct proc *p = &proc[i];
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-        c->proc = 0;
+
+    struct proc *p = rq_pop(&c->rq);
+    if(p == 0) {
+      // idle: steal from the first neighbour with queued work
+      for(int i = 1; i < NCPU && p == 0; i++) {
+        int victim = (me + i) % NCPU;
+        if(cpus[victim].started && cpus[victim].rq.len > 0 &&
+           rq_steal(c, victim) > 0)
+          p = rq_pop(&c->rq);
       }
-      release(&p->lock);
     }
+    if(p == 0) {
+      // nothing to run; wait for the next interrupt
+      asm volatile("wfi");
+      continue;
+    }
+
+    acquire(&p->lock);
+    if(p->state == RUNNABLE) {
+      p->state = RUNNING;
+      c->proc = p;
+      swtch(&c->context, &p->context);
+      c->proc = 0;
+    }
+    release(&p->lock);
+  }
+}
+
+// print per-process resident memory without walking page tables.
+// no locks, to avoid wedging a stuck machine further.
+void
+procdump(void) {
+  static char *states[] = {
+  [UNUSED]    "unused",
+  [USED]      "used",
+  [SLEEPING]  "sleep",
+  [RUNNABLE]  "runble",
+  [RUNNING]   "run",
+  [ZOMBIE]    "zombie"
+  };
+
+  printf("pid state  user pt kstack bufs name\n");
+  for(struct proc *p = proc; p < &proc[NPROC]; p++) {
+    if(p->state == UNUSED)
+      continue;
+    // the root page-table page is not counted by walk()
+    uint64 pt = p->pt_pages + (p->pagetable ? 1 : 0);
+    printf("%d %s %d %d %d %d %s\n", p->pid, states[p->state],
+           (int)p->user_pages, (int)pt, (int)p->kstack_pages,
+           (int)p->bcache_bufs, p->name);
   }
 }
@@ -0,0 +1,49 @@
+#include "riscv.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "panic.h"
+
+static int
+curpid(void) {
+  struct proc *p = myproc();
+  return p ? p->pid : 0;
+}
+
+void
+initsleeplock(struct sleeplock *lk, char *name) {
+  initlock(&lk->lk, "sleep lock");
+  lk->name = name;
+  lk->locked = 0;
+  lk->pid = 0;
+}
+
+void
+acquiresleep(struct sleeplock *lk) {
+  acquire(&lk->lk);
+  while(lk->locked)
+    sleep(lk, &lk->lk);
+  lk->locked = 1;
+  lk->pid = curpid();
+  release(&lk->lk);
+}
+
+void
+releasesleep(struct sleeplock *lk) {
+  acquire(&lk->lk);
+  lk->locked = 0;
+  lk->pid = 0;
+  // one waiter is enough: whoever wins takes the lock and the next
+  // release wakes the next one. a loser just goes back to sleep.
+  wakeup_one(lk);
+  release(&lk->lk);
+}
+
+int
+holdingsleep(struct sleeplock *lk) {
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->locked && lk->pid == curpid();
+  release(&lk->lk);
+  return r;
+}
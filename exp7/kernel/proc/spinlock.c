@@ -0,0 +1,131 @@
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trap.h"
+#include "panic.h"
+#include "defs.h"
+
+#if LOCK_STATS
+// every lock passed to initlock(), pushed lock-free
+static struct spinlock *lock_list;
+#endif
+
+void
+initlock(struct spinlock *lk, char *name) {
+  lk->name = name;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->cpu = 0;
+#if LOCK_STATS
+  lk->acquires = 0;
+  lk->contended = 0;
+  lk->spin_cycles = 0;
+  // re-initialising a lock must not link it twice
+  if(lk->registered)
+    return;
+  lk->registered = 1;
+  struct spinlock *head = __atomic_load_n(&lock_list, __ATOMIC_RELAXED);
+  do {
+    lk->stat_next = head;
+  } while(!__atomic_compare_exchange_n(&lock_list, &head, lk, 0,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#endif
+}
+
+// 关中断后取号并等待叫号；同一 CPU 重复获取视为死锁。
+void
+acquire(struct spinlock *lk) {
+  push_off();
+  if(holding(lk))
+    panic("acquire");
+
+  // amoadd.w
+  unsigned int ticket = __atomic_fetch_add(&lk->next, 1, __ATOMIC_RELAXED);
+
+#if LOCK_STATS
+  if(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket) {
+    uint64 start = r_cycle();
+    while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+      ;
+    // 已持有锁，统计字段无需原子操作
+    lk->contended++;
+    lk->spin_cycles += r_cycle() - start;
+  }
+  lk->acquires++;
+#else
+  while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+    ;
+#endif
+
+  lk->cpu = mycpu();
+}
+
+void
+release(struct spinlock *lk) {
+  if(!holding(lk))
+    panic("release");
+
+  lk->cpu = 0;
+
+  // 叫下一个号；release 语义保证临界区内的写入先于此可见
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+
+  pop_off();
+}
+
+// 当前 CPU 是否持有该锁；调用时须已关中断。
+int
+holding(struct spinlock *lk) {
+  return lk->owner != lk->next && lk->cpu == mycpu();
+}
+
+// push_off/pop_off 与 intr_off/intr_on 类似但可嵌套：
+// 两次 push_off 需要两次 pop_off 才会撤销；
+// 若最外层 push_off 之前中断是关闭的，pop_off 后保持关闭。
+void
+push_off(void) {
+  int old = intr_get();
+  intr_off();
+  struct cpu *c = mycpu();
+  if(c->noff == 0)
+    c->intena = old;
+  c->noff += 1;
+}
+
+void
+pop_off(void) {
+  struct cpu *c = mycpu();
+  if(intr_get())
+    panic("pop_off - interruptible");
+  if(c->noff < 1)
+    panic("pop_off");
+  c->noff -= 1;
+  if(c->noff == 0 && c->intena)
+    intr_on();
+}
+
+// print locks that have seen contention, to find hot spots under
+// multicore load. counters are read without locks.
+void
+lockstat_dump(void) {
+#if LOCK_STATS
+  printf("lock             acquires  contended  spin-cycles\n");
+  for(struct spinlock *lk = lock_list; lk; lk = lk->stat_next) {
+    if(lk->contended == 0)
+      continue;
+    printf("%s %lu %lu %lu\n", lk->name ? lk->name : "?",
+           lk->acquires, lk->contended, lk->spin_cycles);
+  }
+#endif
+}
+
+void
+lockstat_reset(void) {
+#if LOCK_STATS
+  for(struct spinlock *lk = lock_list; lk; lk = lk->stat_next) {
+    lk->acquires = 0;
+    lk->contended = 0;
+    lk->spin_cycles = 0;
+  }
+#endif
+}
@@ -1,4 +1,5 @@
 #include "proc.h"
+#include "timer.h"
 
 int
 sys_getpid(void) {
@@ -12,6 +13,14 @@ sys_yield(void) {
   return 0;
 }
 
+int
+sys_sleep(int n) {
+  if(n < 0)
+    return -1;
+  timer_sleep((uint64)n);
+  return myproc()->killed ? -1 : 0;
+}
+
 int
 sys_kill(int pid) {
   return kill(pid);
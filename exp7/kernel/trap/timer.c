@@ -0,0 +1,247 @@
+#include "riscv.h"
+#include "param.h"
+#include "timer.h"
+#include "proc.h"
+#include "panic.h"
+
+// one wheel per hart, advanced by that hart's timer interrupt to the
+// current time, so ticks skipped while tickless are caught up.
+// level l slot s holds timers due within [64^l, 64^(l+1)) ticks of clk;
+// when level 0 wraps, the next slot of level 1 is cascaded down, etc.
+struct timer_base {
+  struct spinlock lock;
+  uint64 clk;                    // next tick to process; lags while idle
+  struct timer *running;         // callback in progress, for timer_del
+  int pending;                   // timers on the wheel
+  struct timer *wheel[TW_LEVELS][TW_SIZE];
+};
+
+static struct timer_base bases[NCPU];
+
+#define TW_MASK   (TW_SIZE - 1)
+#define TW_MAXDELTA ((1ULL << (TW_BITS * TW_LEVELS)) - 1)
+
+static inline uint64
+now_tick(void) {
+  return r_time() / TICK_INTERVAL;
+}
+
+void
+timerinit(void) {
+  for(int i = 0; i < NCPU; i++) {
+    initlock(&bases[i].lock, "timer");
+    bases[i].clk = now_tick();
+  }
+}
+
+void
+timer_setup(struct timer *t, void (*fn)(void *), void *arg) {
+  t->fn = fn;
+  t->arg = arg;
+  t->period = 0;
+  t->expires = 0;
+  t->next = 0;
+  t->pprev = 0;
+  t->base = 0;
+}
+
+// link t into the slot matching its expiry; base->lock held.
+static void
+enqueue(struct timer_base *base, struct timer *t) {
+  uint64 delta = t->expires - base->clk;
+  struct timer **slot;
+
+  if((long)delta < 0) {
+    // already due: run on the next tick
+    slot = &base->wheel[0][base->clk & TW_MASK];
+  } else {
+    if(delta > TW_MAXDELTA) {
+      t->expires = base->clk + TW_MAXDELTA;
+      delta = TW_MAXDELTA;
+    }
+    int lvl = 0;
+    while(delta >= (1ULL << (TW_BITS * (lvl + 1))))
+      lvl++;
+    slot = &base->wheel[lvl][(t->expires >> (TW_BITS * lvl)) & TW_MASK];
+  }
+  t->next = *slot;
+  if(t->next)
+    t->next->pprev = &t->next;
+  t->pprev = slot;
+  *slot = t;
+  t->base = base;
+  base->pending++;
+}
+
+static void
+dequeue(struct timer_base *base, struct timer *t) {
+  *t->pprev = t->next;
+  if(t->next)
+    t->next->pprev = t->pprev;
+  t->next = 0;
+  t->pprev = 0;
+  base->pending--;
+}
+
+// remove a pending timer and wait out a running callback on another
+// hart, so t may be freed afterwards. returns 1 if t was still pending.
+int
+timer_del(struct timer *t) {
+  struct timer_base *base;
+  int was_pending = 0;
+
+  while((base = t->base) != 0) {
+    acquire(&base->lock);
+    if(t->base != base) {
+      // re-armed on another hart meanwhile
+      release(&base->lock);
+      continue;
+    }
+    if(t->pprev) {
+      dequeue(base, t);
+      was_pending = 1;
+    }
+    // the callback itself may re-arm or delete its timer: don't wait on it
+    if(base->running != t || base == &bases[cpuid()]) {
+      t->base = 0;
+      release(&base->lock);
+      break;
+    }
+    release(&base->lock);
+  }
+  return was_pending;
+}
+
+// arm t to fire delay ticks from now on this hart's wheel.
+void
+timer_add(struct timer *t, uint64 delay, uint64 period) {
+  timer_del(t);
+
+  push_off();
+  struct timer_base *base = &bases[cpuid()];
+  acquire(&base->lock);
+  // relative to real time: clk may lag behind on a tickless hart
+  t->expires = now_tick() + delay;
+  t->period = period;
+  enqueue(base, t);
+  release(&base->lock);
+  pop_off();
+}
+
+// re-file every timer of one higher-level slot; returns the slot index.
+static int
+cascade(struct timer_base *base, int lvl) {
+  int idx = (base->clk >> (TW_BITS * lvl)) & TW_MASK;
+  struct timer *t = base->wheel[lvl][idx];
+
+  base->wheel[lvl][idx] = 0;
+  while(t) {
+    struct timer *next = t->next;
+    base->pending--;
+    enqueue(base, t);
+    t = next;
+  }
+  return idx;
+}
+
+// one tick of the wheel: cascade if level 0 wrapped, then run the slot.
+// base->lock held; dropped around each callback.
+static void
+run_one_tick(struct timer_base *base) {
+  int idx = base->clk & TW_MASK;
+  for(int lvl = 1; idx == 0 && lvl < TW_LEVELS; lvl++)
+    idx = cascade(base, lvl);
+  idx = base->clk & TW_MASK;
+
+  // run this slot one timer at a time, without the lock held
+  struct timer *t;
+  while((t = base->wheel[0][idx]) != 0) {
+    dequeue(base, t);
+    if(t->period) {
+      t->expires = base->clk + t->period;
+      enqueue(base, t);
+    }
+    base->running = t;
+    release(&base->lock);
+    t->fn(t->arg);
+    acquire(&base->lock);
+    base->running = 0;
+    // a periodic timer lands in a later slot, so this loop terminates
+  }
+  base->clk++;
+}
+
+// called from the timer interrupt on every hart, interrupts off.
+// processes every tick up to now, skipping ahead if the wheel is empty.
+void
+timer_tick(void) {
+  struct timer_base *base = &bases[cpuid()];
+  uint64 now = now_tick();
+
+  acquire(&base->lock);
+  while(base->clk <= now) {
+    if(base->pending == 0) {
+      base->clk = now + 1;
+      break;
+    }
+    run_one_tick(base);
+  }
+  release(&base->lock);
+}
+
+// tick at which the earliest pending timer on this hart expires, or ~0
+// if none. scans the wheel; only used when deciding how long to idle.
+uint64
+timer_next_expiry(void) {
+  push_off();
+  struct timer_base *base = &bases[cpuid()];
+  uint64 best = ~0ULL;
+
+  acquire(&base->lock);
+  if(base->pending) {
+    for(int lvl = 0; lvl < TW_LEVELS; lvl++)
+      for(int i = 0; i < TW_SIZE; i++)
+        for(struct timer *t = base->wheel[lvl][i]; t; t = t->next) {
+          uint64 e = (long)(t->expires - base->clk) < 0 ? base->clk : t->expires;
+          if(e < best)
+            best = e;
+        }
+  }
+  release(&base->lock);
+  pop_off();
+  return best;
+}
+
+struct sleeper {
+  struct proc *p;
+  int fired;
+};
+
+static void
+sleeper_wake(void *arg) {
+  struct sleeper *s = arg;
+
+  // setting fired under p->lock orders it against the sleeper's check
+  acquire(&s->p->lock);
+  s->fired = 1;
+  release(&s->p->lock);
+  wakeup(s);
+}
+
+// put the current process to sleep for nticks; only its own timer fires.
+void
+timer_sleep(uint64 nticks) {
+  struct proc *p = myproc();
+  struct sleeper s = { p, 0 };
+  struct timer t;
+
+  if(p == 0)
+    panic("timer_sleep");
+  timer_setup(&t, sleeper_wake, &s);
+  acquire(&p->lock);
+  timer_add(&t, nticks, 0);
+  while(!s.fired && !p->killed)
+    sleep(&s, &p->lock);
+  release(&p->lock);
+  timer_del(&t);
+}
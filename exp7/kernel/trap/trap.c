@@ -3,13 +3,12 @@
 #include "panic.h"
 #include "string.h"
 #include "proc.h"
+#include "timer.h"
 
 #define INST_16_MASK 0x3
 
-#define TICK_INTERVAL 100000ULL
-
 static interrupt_handler_t irq_table[IRQ_MAX];
-static volatile uint64 ticks;
+static uint64 boot_time;
 
 static void timer_interrupt_handler(void);
 static void set_next_timer_tick(void);
@@ -31,8 +30,13 @@ extern void kernelvec(void);
 
 void trap_init(void) {
   memset((void *)irq_table, 0, sizeof(irq_table));
-  ticks = 0;
+  boot_time = r_time();
+  timerinit();
   register_interrupt(IRQ_S_TIMER, timer_interrupt_handler);
+}
+
+// 每个 hart 各自设置 stvec
+void trap_inithart(void) {
   w_stvec((uint64)kernelvec);
 }
 
@@ -88,12 +92,17 @@ void intr_off(void) {
   w_sstatus(r_sstatus() & ~SSTATUS_SIE);
 }
 
+int intr_get(void) {
+  return (r_sstatus() & SSTATUS_SIE) != 0;
+}
+
 uint64 get_time(void) {
   return r_time();
 }
 
+// 动态 tick 下各 hart 的中断不再等间隔，ticks 直接由 time 折算
 uint64 get_ticks(void) {
-  return ticks;
+  return (r_time() - boot_time) / TICK_INTERVAL;
 }
 
 static void dispatch_interrupt(int irq) {
@@ -132,19 +141,35 @@ void kerneltrap(void) {
     sstatus = tf.sstatus;
   }
 
-  sstatus |= SSTATUS_SIE;
+  // yield() 可能改写了 sepc/sstatus，按陷入时的值恢复，
+  // sret 依据 SPIE 还原被打断代码的中断状态
   w_sepc(sepc);
   w_sstatus(sstatus);
 }
 
+// 有进程在本 hart 排队时按周期 tick 抢占；否则（空闲或只有一个进程在跑）
+// 只按最近的定时器到期时间设置 stimecmp，最长 NOHZ_MAX_TICKS
 static void set_next_timer_tick(void) {
-  uint64 next = get_time() + TICK_INTERVAL;
-  w_stimecmp(next);
+  uint64 now = get_time() / TICK_INTERVAL;
+  uint64 next = now + 1;
+
+  if(mycpu()->rq.len == 0) {
+    uint64 expiry = timer_next_expiry();
+    next = now + NOHZ_MAX_TICKS;
+    if(expiry < next)
+      next = expiry > now ? expiry : now + 1;
+  }
+  w_stimecmp(next * TICK_INTERVAL);
+}
+
+// 本 hart 的运行队列刚变为非空：下一个 tick 就来中断，恢复周期抢占
+void timer_resume_tick(void) {
+  w_stimecmp((get_time() / TICK_INTERVAL + 1) * TICK_INTERVAL);
 }
 
 static void timer_interrupt_handler(void) {
-  ticks++;
-  wakeup((void *)&ticks);
+  // 定时睡眠由各 hart 自己的时间轮唤醒，不再每 tick 广播
+  timer_tick();
   set_next_timer_tick();
   w_sip(r_sip() & ~SIP_STIP);
 }
@@ -4,6 +4,7 @@
 
 #include "types.h"
 #include "fs.h"
+#include "sleeplock.h"
 
 // 块缓存结构
 struct buf {
@@ -11,7 +12,7 @@ struct buf {
     int disk;           // 是否需要写回磁盘
     uint32_t dev;       // 设备号
     uint32_t blockno;   // 块号
-    volatile int lock;  // 保护缓存内容的锁
+    struct sleeplock lock;  // 保护缓存内容的锁，bread 获取、brelse 释放
     uint32_t refcnt;    // 引用计数
     struct buf *prev;   // LRU链表前驱
     struct buf *next;   // LRU链表后继
@@ -25,6 +26,7 @@ void bwrite(struct buf *b);
 void brelse(struct buf *b);
 void bpin(struct buf *b);
 void bunpin(struct buf *b);
+int bcache_nbuf(void);
 
 #endif // _BIO_H_
 
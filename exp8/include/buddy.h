@@ -10,28 +10,37 @@
 #define BUDDY_ALLOCATED   1
 #define BUDDY_SPLIT       2
 
-// 伙伴系统结构
-struct buddy_pool {
-    struct list_head free_lists[BUDDY_MAX_ORDER + 1];  // 各阶空闲链表
-    uint64_t pool_start;         // 内存池起始地址
-    uint64_t pool_size;          // 内存池大小
-    uint8_t *bitmap;             // 位图，用于跟踪页面状态
+// 各阶空闲块链表
+struct free_area {
+    struct list_head free_list;  // 空闲块首页的 page 描述符链表
+    uint64_t nr_free;            // 该阶空闲块数量
+};
+
+// 内存区：物理内存管理的唯一数据源，伙伴系统作为其后端
+struct zone {
+    const char *name;            // 区名
+    uint64_t zone_start;         // 可分配内存起始地址（页描述符数组之后）
+    uint64_t zone_end;           // 可分配内存结束地址
+    struct page *mem_map;        // 页描述符数组，每个可分配页一项
     uint64_t total_pages;        // 总页数
-    uint64_t used_pages;         // 已使用页数
-    uint64_t bitmap_size;        // 位图大小
+    uint64_t used_pages;         // 不在空闲链表中的页数，含 pmm 单页前端缓存暂存的页
+    struct free_area free_area[BUDDY_MAX_ORDER + 1];  // 各阶空闲链表
 };
 
 // 伙伴系统API
-void buddy_init(void);
+void buddy_init(uint64_t start, uint64_t end);
 void* buddy_alloc(int order);
 void buddy_free(void* addr, int order);
+void buddy_free_range(void* addr, int count);   // 按对齐块拆分归还任意页数
+int buddy_owns(void* addr);                      // 地址是否属于内存区
 void buddy_dump(void);
 uint64_t buddy_get_total_pages(void);
 uint64_t buddy_get_used_pages(void);
+uint64_t buddy_get_free_blocks(uint64_t *nr_free);  // 各阶空闲块数，返回空闲页总数
 
 // 内部函数声明
 void set_buddy_status(uint64_t index, int order, int status);
 int get_buddy_status(uint64_t index, int order);
 int is_buddy_free(uint64_t index, int order);
 
-#endif
\ No newline at end of file
+#endif
@@ -6,6 +6,9 @@
 
 #define CLOCK_FREQ 10000000
 
+// 时间轮粒度：0.05 秒，三种间隔都是它的整数倍
+#define TICK_CYCLES     (CLOCK_FREQ / 20)
+
 // 三种不同的时钟间隔
 #define INTERVAL_FAST   (CLOCK_FREQ / 10)    // 0.1秒 - 快速
 #define INTERVAL_MEDIUM (CLOCK_FREQ / 4)     // 0.25秒 - 中等
@@ -19,10 +22,41 @@ typedef enum {
     NUM_TIMERS
 } timer_type_t;
 
+// 分层时间轮：4 层，每层 64 槽，覆盖 2^24 个 tick
+#define TW_BITS   6
+#define TW_SIZE   (1 << TW_BITS)
+#define TW_LEVELS 4
+
+// 调度 tick：只在有进程竞争 CPU 时启用
+#define SCHED_TICKS     (INTERVAL_FAST / TICK_CYCLES)
+
+// 可延迟定时器：调度 tick 关闭时不单独唤醒 CPU，下次中断时补跑
+#define TIMER_DEFERRABLE 0x1
+
+// 通用定时器：一次性（period == 0）或周期性，回调在时钟中断中执行，不能睡眠
+struct timer {
+    uint64_t expires;             // 到期 tick
+    uint64_t period;              // 周期（tick），0 表示一次性
+    int flags;                    // TIMER_DEFERRABLE
+    void (*fn)(void *arg);
+    void *arg;
+    struct timer *next;
+    struct timer **pprev;         // 非空表示挂在时间轮上
+};
+
 // 时钟管理函数
 void clock_init(void);
 void clock_set_next_event(void);
 uint64_t get_ticks(timer_type_t timer);
 void reset_ticks(timer_type_t timer);
 
-#endif
\ No newline at end of file
+// 定时器接口
+void timer_setup(struct timer *t, void (*fn)(void *), void *arg);
+void timer_add(struct timer *t, uint64_t delay, uint64_t period);
+int timer_del(struct timer *t);
+uint64_t clock_now(void);             // 当前 tick
+void clock_set_tick(int on);          // 开关调度 tick（动态 tick）
+int clock_need_resched(void);         // 调度 tick 到期过则返回 1 并清除标志
+void clock_sleep(uint64_t nticks);    // 当前进程睡眠 nticks 个 tick
+
+#endif
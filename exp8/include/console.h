@@ -1,12 +1,20 @@
 #ifndef _CONSOLE_H_
 #define _CONSOLE_H_
 
+// 每个 CPU 行缓冲的大小，满一行即发布到控制台输出环
+#define CONSOLE_LINE 128
+
 // 控制台初始化
 void console_init(void);
 
 // 输出函数
 void console_putc(char c);
 void console_puts(const char *s);
+void console_begin(void);     // 与 console_end 配对，其间的输出作为整体发布
+void console_end(void);
+void console_drain(void);     // 启动 UART 发送输出环中已提交的记录
+void console_flush(void);     // 同步送完输出环
+int console_tx_getc(char *c); // UART 发送端取一个字节，0 表示暂无输出
 
 // 高级控制功能
 void clear_screen(void);
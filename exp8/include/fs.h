@@ -4,6 +4,7 @@
 
 #include "types.h"
 #include "proc.h"
+#include "sleeplock.h"
 
 // 文件系统常量
 #define BSIZE           4096        // 块大小：4KB
@@ -12,7 +13,9 @@
 #define NINDIRECT       (BSIZE / sizeof(uint32_t))  // 间接块可索引的块数
 #define MAXFILE         (NDIRECT + NINDIRECT)       // 最大文件块数
 #define MAXOPBLOCKS     10          // 最大操作块数
-#define LOGSIZE         (MAXOPBLOCKS * 3)  // 日志大小
+#ifndef LOGSIZE
+#define LOGSIZE         64          // 日志区块数（含日志头），可用 -DLOGSIZE= 调整
+#endif
 #define FSSIZE          2000        // 文件系统大小（块数）
 
 // 超级块位置
@@ -57,7 +60,7 @@ struct inode {
     uint32_t dev;          // 设备号
     uint32_t inum;         // inode号
     int ref;               // 引用计数
-    volatile int lock;     // 保护inode内容的锁
+    struct sleeplock lock; // 保护inode内容的锁（ilock/iunlock）
     int valid;             // inode已从磁盘读取？
     
     // 从磁盘拷贝的内容
@@ -112,6 +115,8 @@ struct inode* namei(char *path);
 struct inode* nameiparent(char *path, char *name);
 struct inode* iget(uint32_t dev, uint32_t inum);
 void iput(struct inode *ip);
+void ilock(struct inode *ip);
+void iunlock(struct inode *ip);
 void iunlockput(struct inode *ip);
 struct inode* ialloc(uint32_t dev, uint16_t type);
 void iupdate(struct inode *ip);
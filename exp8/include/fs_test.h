@@ -5,6 +5,7 @@
 void test_filesystem_integrity(void);
 void test_concurrent_access(void);
 void test_filesystem_performance(void);
+void test_log_reservation(void);
 void run_filesystem_tests(void);
 
 #endif // _FS_TEST_H_
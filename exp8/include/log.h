@@ -5,11 +5,7 @@
 #include "types.h"
 #include "fs.h"
 #include "bio.h"
-
-// 简单的自旋锁结构（用于日志系统）
-struct spinlock {
-    volatile int locked;
-};
+#include "spinlock.h"
 
 // 日志头结构
 struct logheader {
@@ -23,19 +19,19 @@ struct log {
     int start;                  // 日志区起始块号
     int size;                   // 日志区大小
     int outstanding;            // 未完成的系统调用数
+    int reserved;               // 未完成事务预留的日志块数
+    int ncommit;                // 已提交的事务组数（统计用）
     int committing;             // 是否正在提交
     int dev;                    // 设备号
     struct logheader lh;        // 日志头
 };
 
-// 自旋锁操作
-void acquire(struct spinlock *lk);
-void release(struct spinlock *lk);
-
 // 日志系统函数
 void initlog(int dev, struct superblock *sb);
 void begin_op(void);
 void end_op(void);
+int begin_op_n(int want);       // 预留最多 want 块日志空间，返回实际预留块数
+void end_op_n(int granted);
 void log_write(struct buf *b);
 void commit(void);
 void recover_from_log(void);
@@ -72,6 +72,16 @@ static inline int list_empty(struct list_head *head) {
     for (pos = (head)->next, n = pos->next; pos != (head); \
          pos = n, n = pos->next)
 
+/* 页描述符：每个物理页一项，集中存放在内存区头部，空闲页本身不被改写 */
+#define PG_FREE       (1 << 0)   // 该页是空闲块的块首
+#define PG_RESERVED   (1 << 1)   // 该页不参与分配
+
+struct page {
+    struct list_head list;       // 空闲链表节点（仅空闲块首有效）
+    uint8_t order;               // 块阶数（仅块首有效）
+    uint8_t flags;               // PG_FREE / PG_RESERVED
+};
+
 /* Slab分配器配置 */
 #define SLAB_CACHE_SIZE   8      // Slab缓存数量
 #define SLAB_MIN_SIZE     32     // 最小对象大小
@@ -93,7 +103,23 @@ void free_page(void* page);      // 释放一页物理内存
 
 /* PMM 统计变量 - 外部声明 */
 extern int total_pages;          //总页数
-extern int used_pages;           //已使用页数
+extern int used_pages;           //已交给调用者的页数，不含前端缓存中的页
+
+/* 内存压力统计快照（sys_meminfo 返回的结构），只读各类计数器，O(阶数) */
+struct meminfo {
+    uint64_t total_pages;                        // 内存区可分配总页数
+    uint64_t free_pages;                         // 空闲页数（伙伴系统 + 单页缓存）
+    uint64_t free_blocks[BUDDY_MAX_ORDER + 1];   // 各阶空闲块数量
+    uint64_t cached_pages;                       // 单页前端缓存中的页数
+    uint64_t slab_pages;                         // slab 占用页数（尚未实现 slab，恒为0）
+    uint64_t bcache_bufs;                        // 块缓存缓冲区个数
+    uint64_t bcache_bytes;                       // 块缓存占用字节数
+    uint64_t pagetable_pages;                    // 页表页数量
+    uint64_t alloc_page_failures;                // alloc_page 失败次数
+    uint64_t alloc_pages_failures;               // alloc_pages 失败次数
+};
+
+void pmm_get_meminfo(struct meminfo *mi);  // 填充内存统计快照
 
 /* Virtual Memory Manager */
 //虚拟内存管理器
@@ -106,6 +132,8 @@ pte_t* walk_lookup(pagetable_t pt, uint64_t va);        // 查找虚拟地址对
 void free_pagetable(pagetable_t pt);   // 释放页表
 void dump_pagetable(pagetable_t pt);   // 打印页表内容
 
+extern uint64_t pagetable_pages;      // 已分配的页表页数量
+
 /* Kernel Virtual Memory */
 //内核虚拟内存函数
 void kvminit(void);    // 初始化内核虚拟内存空间
@@ -122,12 +150,15 @@ void free_pages(void* start, int count);
 // void get_cache_stats(void);
 
 /* Buddy System */
-void buddy_init(void);
+void buddy_init(uint64_t start, uint64_t end);
 void* buddy_alloc(int order);
 void buddy_free(void* addr, int order);
+void buddy_free_range(void* addr, int count);
+int buddy_owns(void* addr);
 void buddy_dump(void);
 uint64_t buddy_get_total_pages(void);
 uint64_t buddy_get_used_pages(void);
+uint64_t buddy_get_free_blocks(uint64_t *nr_free);
 
 // /* Slab Allocator */
 // void slab_init(void);
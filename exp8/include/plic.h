@@ -0,0 +1,22 @@
+// include/plic.h - 平台级中断控制器（QEMU virt）
+#ifndef _PLIC_H_
+#define _PLIC_H_
+
+#include "types.h"
+
+#define PLIC_BASE 0x0c000000UL
+
+// 中断源编号
+#define UART0_IRQ 10
+
+// 寄存器布局：M 模式下 hart n 的上下文号为 2n
+#define PLIC_PRIORITY(irq)     (PLIC_BASE + (irq) * 4)
+#define PLIC_MENABLE(hart)     (PLIC_BASE + 0x2000 + (hart) * 0x100)
+#define PLIC_MTHRESHOLD(hart)  (PLIC_BASE + 0x200000 + (hart) * 0x2000)
+#define PLIC_MCLAIM(hart)      (PLIC_BASE + 0x200004 + (hart) * 0x2000)
+
+void plic_init(void);             // 设置中断源优先级并对本 hart 使能
+int plic_claim(void);             // 取得待处理的中断源，0 表示没有
+void plic_complete(int irq);      // 通知 PLIC 该中断源已处理完
+
+#endif // _PLIC_H_
@@ -5,8 +5,11 @@
 #include "types.h"
 #include "mm.h"
 #include "trap.h"  // 添加这行
+#include "spinlock.h"
+#include "console.h"
 
 #define NPROC 32
+#define NCPU 1          // 目前只启动 hart 0
 #define STACK_SIZE 4096
 
 #define PRIORITY_MIN 0//最小优先级
@@ -52,11 +55,18 @@ struct proc {
     pagetable_t pagetable;
     struct proc *parent;
     void *chan;
+    struct proc *wait_next;            // 等待队列哈希桶链表
+    int on_waitq;                      // 是否挂在等待队列上
     int killed;
     int xstate;
     char name[16];
     struct trap_context *trap_context; // 添加陷阱上下文指针
+    int syscall_err;                   // 当前系统调用的错误码，由分发器写入 a0
     uint64_t sz;                       // 进程大小
+    uint64_t user_pages;               // 已映射的用户页数
+    uint64_t pt_pages;                 // 私有页表页数（共享内核页表时为0）
+    uint64_t kstack_pages;             // 内核栈页数
+    uint64_t bcache_bufs;              // 当前持有的块缓存缓冲区数（bread 未 brelse）
     int priority;                      // 静态优先级（数值越大越重要）
     int ticks;                         // 已消耗的时间片数量
     int wait_time;                     // 等待时长（用于aging）
@@ -64,14 +74,42 @@ struct proc {
     int queue_ticks;                   // 在当前层级已消耗的时间片数
 };
 
+// 每个 CPU 的私有数据：tp 寄存器保存本 CPU 的 struct cpu 地址（entry.S 设置），
+// 访问只需一次基于 tp 的加载，且不会因为被抢占而读到别的 CPU 的数据
+struct cpu {
+    struct proc *proc;           // 当前运行的进程
+    struct context scheduler;    // 调度器上下文
+    int noff;                    // push_off 嵌套深度
+    int intena;                  // 最外层 push_off 之前 MIE 是否打开
+    uint64_t nswitch;            // 上下文切换次数
+    uint64_t nintr;              // 中断次数
+    uint64_t nsyscall;           // 系统调用次数
+    char cons_line[CONSOLE_LINE];// 控制台行缓冲，凑满一行再发布到输出环
+    int cons_len;                // 行缓冲已用字节数
+    int cons_depth;              // console_begin 嵌套深度
+};
+
+extern struct cpu cpus[NCPU];
+
+static inline struct cpu* mycpu(void) {
+    struct cpu *c;
+    asm volatile("mv %0, tp" : "=r"(c));
+    return c;
+}
+
+static inline int cpuid(void) {
+    return mycpu() - cpus;
+}
+
+// 访问本 CPU 的字段，如 this_cpu(nintr)++
+#define this_cpu(field) (mycpu()->field)
+#define curr_proc this_cpu(proc)
+
 // 系统调用
 extern struct proc proc[NPROC];
-extern struct proc *curr_proc;
-extern volatile int proc_lock;
+extern struct spinlock proc_lock;
 
 // 函数声明
-void spin_lock(volatile int *lock);
-void spin_unlock(volatile int *lock);
 void proc_init(void);
 struct proc* alloc_proc(void);
 int create_process(void (*entry)(void));
@@ -79,8 +117,11 @@ void exit_process(int status);
 int wait_process(int *status);
 void scheduler(void);
 void yield(void);
+void sched_kick(void);               // 有进程变为就绪时调用（动态 tick）
 void sleep(void *chan);
 void wakeup(void *chan);
+void wakeup_one(void *chan);
+int wakeup_n(void *chan, int n);     // 返回实际唤醒个数
 int proc_set_priority(int pid, int priority);//设置进程优先级
 int proc_get_priority(int pid);//获取进程优先级
 
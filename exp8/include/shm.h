@@ -0,0 +1,27 @@
+// include/shm.h - 共享内存段与 futex
+#ifndef _SHM_H_
+#define _SHM_H_
+
+#include "types.h"
+
+#define NSHM          16    // 共享内存段数
+#define SHM_MAX_PAGES 16    // 单个段最多页数
+#define SHM_PRIVATE   0     // key 为 0 时总是新建一个段
+
+struct proc;
+
+// 共享内存段：按 key 查找或创建，挂接返回段的地址。
+// 所有进程共用内核页表，段的虚拟地址即物理地址，挂接不需要改页表
+// 以下函数成功返回 >= 0，失败返回负的 SYSERR_* 错误码
+void shm_init(void);
+int shm_get(int key, int size);          // 返回段号
+int shm_attach(int id, uint64_t *addr);  // 段地址写入 *addr
+int shm_detach(uint64_t addr);           // 最后一个挂接者解除时释放段
+int shm_remove(int id);                  // 不再可查找/挂接，没有挂接者时立即释放
+void shm_release(struct proc *p);        // 进程退出时解除其全部挂接
+
+// futex：按字的物理地址排队。只在竞争时才需要陷入内核
+int futex_wait(uint64_t addr, int val);  // *addr == val 时睡眠，被唤醒返回 0
+int futex_wake(uint64_t addr, int n);    // 最多唤醒 n 个，返回实际唤醒数
+
+#endif
@@ -0,0 +1,20 @@
+// kernel/sleeplock.h - 睡眠锁
+#ifndef _SLEEPLOCK_H_
+#define _SLEEPLOCK_H_
+
+#include "types.h"
+
+// 睡眠锁：持有期间可以长时间拷贝或等待磁盘，竞争者睡眠让出 CPU 而不是自旋
+// 单核：检查 locked 与挂入等待队列之间关中断，防止被时钟中断抢占而丢失唤醒
+struct sleeplock {
+    volatile int locked;   // 是否被持有
+    const char *name;      // 锁名（调试用）
+    int pid;               // 持有者进程号，无进程上下文（启动阶段）时为 0
+};
+
+void initsleeplock(struct sleeplock *lk, const char *name);
+void acquiresleep(struct sleeplock *lk);
+void releasesleep(struct sleeplock *lk);
+int holdingsleep(struct sleeplock *lk);
+
+#endif // _SLEEPLOCK_H_
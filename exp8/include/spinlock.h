@@ -0,0 +1,43 @@
+// kernel/spinlock.h - 排队（票号）自旋锁
+#ifndef _SPINLOCK_H_
+#define _SPINLOCK_H_
+
+#include "types.h"
+
+// 置 0 可去掉统计计数，acquire 退化为纯票号锁
+#ifndef LOCK_STATS
+#define LOCK_STATS 1
+#endif
+
+// 票号锁：按取号顺序 FIFO 获得锁，等待者只读 owner
+// 全零即为未上锁状态，静态定义的锁无需 initlock 也能使用
+struct spinlock {
+    volatile uint32_t next;      // 下一个待发放的票号
+    volatile uint32_t owner;     // 当前持有锁的票号
+    const char *name;            // 锁名（调试/统计用）
+#if LOCK_STATS
+    uint64_t acquires;           // 获取次数
+    uint64_t contended;          // 需要等待的获取次数
+    uint64_t spin_cycles;        // 等待消耗的总周期数
+    struct spinlock *stat_next;  // 已注册锁链表
+    int registered;
+#endif
+};
+
+// 锁统计（sys_lockstat 返回给用户的结构）
+struct lockstat {
+    char name[16];
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t spin_cycles;
+};
+
+void initlock(struct spinlock *lk, const char *name);
+void acquire(struct spinlock *lk);    // 持有期间关中断（push_off）
+void release(struct spinlock *lk);
+void push_off(void);                  // 可嵌套的关中断，与 pop_off 配对
+void pop_off(void);
+int lockstat_collect(struct lockstat *out, int max);  // 返回写入的条目数
+void lockstat_reset(void);
+
+#endif // _SPINLOCK_H_
@@ -28,6 +28,16 @@
 #define SYS_unlink   20     // 删除文件
 #define SYS_setpriority 21
 #define SYS_getpriority 22
+#define SYS_meminfo  23     // 获取内存统计信息
+#define SYS_lockstat 24     // 获取锁竞争统计（调试用）
+#define SYS_trace    25     // 设置系统调用跟踪掩码（调试用）
+#define SYS_syscallstats 26 // 打印系统调用统计（调试用）
+#define SYS_shmget   27     // 按 key 获取/创建共享内存段
+#define SYS_shmat    28     // 挂接共享内存段，返回段地址
+#define SYS_shmdt    29     // 解除挂接
+#define SYS_futex_wait 30   // *addr == val 时睡眠
+#define SYS_futex_wake 31   // 唤醒 addr 上最多 n 个进程
+#define SYS_shmrm    32     // 删除共享内存段
 
 #define SYSCALL_MAX  64
 
@@ -37,6 +47,11 @@ struct procinfo {
     int state;         // 进程状态
     int parent_pid;    // 父进程ID
     char name[16];     // 进程名称
+    uint64_t sz;            // 进程大小
+    uint64_t user_pages;    // 已映射的用户页数
+    uint64_t pt_pages;      // 私有页表页数
+    uint64_t kstack_pages;  // 内核栈页数
+    uint64_t bcache_bufs;   // 持有的块缓存缓冲区数
 };
 
 // 错误码定义
@@ -55,25 +70,41 @@ struct syscall_desc {
     char *name;
     int arg_count;
     uint32_t arg_types;
-    int permission;
 };
 
-// 系统调用结果
-typedef struct {
-    long return_value;
-    int error;
-} syscall_result_t;
+// 单个系统调用的统计：次数、失败次数与 log2 分桶的延迟直方图（time CSR 计数）
+#define SYSCALL_HIST_BUCKETS 20
+
+struct syscall_stat {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t hist[SYSCALL_HIST_BUCKETS];  // 桶 0 为 0，桶 i 为 [2^(i-1), 2^i)，最后一桶收纳更大的值
+};
 
 // 系统调用表声明
 extern struct syscall_desc syscall_table[SYSCALL_MAX];
 
 // 系统调用接口
 void syscall_init(void);
-void syscall_dispatch(struct trap_context *ctx);
-int check_syscall_permission(struct proc *p, int syscall_num);
+void syscall_dispatch(struct trap_context *ctx);  // 失败时 a0 为负的 SYSERR_* 错误码
+void syscall_set_trace(uint64_t mask);            // 第 n 位置 1 时跟踪 n 号系统调用
+int syscall_stat_get(int num, struct syscall_stat *out);  // 汇总各 CPU 的统计
+void syscall_stats_reset(void);
+void syscall_stats_dump(void);
 
 // 在系统调用函数声明部分添加：
 int sys_getprocinfo(void);
+int sys_meminfo(void);
+int sys_lockstat(void);
+int sys_sleep(void);
+int sys_trace(void);
+int sys_syscallstats(void);
+int sys_shmget(void);
+int sys_shmat(void);
+int sys_shmdt(void);
+int sys_futex_wait(void);
+int sys_futex_wake(void);
+int sys_shmrm(void);
 
 // 参数提取函数
 int argint(int n, int *ip);
@@ -11,6 +11,11 @@ void test_parameter_passing(void);
 void test_security(void);
 void test_syscall_performance(void);
 void test_getprocinfo(void);  // 新增测试函数
+void test_meminfo(void);
+void test_timer_wheel(void);
+void test_syscall_stats(void);
+void test_shm_futex(void);
+void test_trap_paths(void);
 void run_comprehensive_syscall_tests(void);
 
 // 系统调用包装函数声明（用于测试）
@@ -71,9 +71,27 @@ struct trap_context {
     uint64_t mtval;
 };
 
+// mstatus.MIE 开关；需要可嵌套的关中断时用 push_off/pop_off
+static inline void intr_on(void) {
+    asm volatile("csrs mstatus, %0" : : "r"(1 << 3));
+}
+
+static inline void intr_off(void) {
+    asm volatile("csrc mstatus, %0" : : "r"(1 << 3));
+}
+
+static inline int intr_get(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mstatus" : "=r"(x));
+    return (x >> 3) & 1;
+}
+
 // 函数声明
 void trap_init(void);
-void trap_handler(struct trap_context *ctx);
+void trap_handler(struct trap_context *ctx, uint64_t cause);
+int trap_timer_interrupt(void);
+int trap_external_interrupt(void);
+int trap_unknown_interrupt(void);
 void enable_interrupts(void);
 void disable_interrupts(void);
 
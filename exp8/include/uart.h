@@ -17,6 +17,14 @@
 
 // 中断使能寄存器位
 #define IER_RX_ENABLE (1 << 0)  // 接收中断使能
+#define IER_TX_ENABLE (1 << 1)  // 发送保持寄存器空中断使能
+
+// FIFO控制寄存器位
+#define FCR_FIFO_ENABLE (1 << 0)
+#define FCR_FIFO_CLEAR  (3 << 1)  // 清空收发 FIFO
+
+#define UART_FIFO_SIZE  16        // 16550 发送 FIFO 深度，一次发送空中断最多写入的字节数
+#define UART_RX_BUF     256       // 接收环大小（2 的幂）
 
 // UART 函数声明
 void uart_init(void);
@@ -24,8 +32,10 @@ void uart_putc(char c);
 void uart_puts(char *s);
 int uart_input_available(void);
 char uart_getc(void);
+int uart_read(char *dst, int n);      // 从接收环读取，没有输入时睡眠
+void uart_tx_kick(int sync);          // 把控制台输出环送往 UART，sync=1 时轮询直到送完
 
-// 新增中断相关函数
+// 中断相关函数
 void uart_enable_rx_interrupt(void);
 void uart_disable_interrupts(void);
 int uart_check_interrupt(void);
@@ -4,6 +4,9 @@
 
 #include "types.h"
 
+struct meminfo;
+struct lockstat;
+
 // 系统调用声明
 int fork(void);
 int exit(int status) __attribute__((noreturn));
@@ -21,6 +24,14 @@ int read(int fd, void* buf, int count);
 int sleep(int ticks);
 int setpriority(int pid, int value);//设置进程优先级
 int getpriority(int pid);//获取进程优先级
+int meminfo(struct meminfo* info);//获取内存统计信息
+int lockstat(struct lockstat* buf, int n);//获取锁竞争统计，n=0 清零
+int shmget(int key, int size);//获取/创建共享内存段，返回段号
+int shmat(int id, uint64_t* addr);//挂接共享内存段，段地址写入 *addr
+int shmdt(uint64_t addr);//解除挂接
+int futex_wait(volatile int* addr, int val);//*addr == val 时睡眠
+int futex_wake(volatile int* addr, int n);//唤醒最多 n 个等待者
+int shmrm(int id);//删除共享内存段，最后一个挂接者解除后释放
 
 // 标准库函数
 int strlen(const char* s);
@@ -29,7 +29,7 @@ void binit(void) {
         b->refcnt = 0;
         b->valid = 0;
         b->disk = 0;
-        b->lock = 0;
+        initsleeplock(&b->lock, "buffer");
         head.next->prev = b;
         head.next = b;
     }
@@ -71,8 +71,9 @@ static struct buf* bget(uint32_t dev, uint32_t blockno) {
     }
     
     // 如果所有块都被引用，使用LRU策略强制替换（从链表头取最老的）
-    // 这不应该发生，但如果发生了，我们强制替换
-    b = head.next;
+    // 这不应该发生，但如果发生了，我们强制替换；正被持有的块不能抢
+    for (b = head.next; b != &head && b->lock.locked; b = b->next)
+        ;
     if (b != &head) {
         // 如果块需要写回，先写回
         if (b->disk && b->valid) {
@@ -100,19 +101,21 @@ static struct buf* bget(uint32_t dev, uint32_t blockno) {
 struct buf* bread(uint32_t dev, uint32_t blockno) {
     struct buf *b;
     
+    if (blockno >= FSSIZE) {
+        printf("bio: invalid blockno %d\n", blockno);
+        return NULL;
+    }
+    
     b = bget(dev, blockno);
     if (!b) {
         printf("bio: failed to get buffer for dev=%d blockno=%d\n", dev, blockno);
         return NULL;
     }
     
+    // 其他进程正在使用该块时睡眠等待，而不是自旋
+    acquiresleep(&b->lock);
+    
     if (!b->valid) {
-        // 从磁盘读取
-        if (blockno >= FSSIZE) {
-            printf("bio: invalid blockno %d\n", blockno);
-            return NULL;
-        }
-        
         // 从内存磁盘读取
         uint8_t *src = &disk[blockno * BSIZE];
         for (int i = 0; i < BSIZE; i++) {
@@ -122,6 +125,10 @@ struct buf* bread(uint32_t dev, uint32_t blockno) {
         b->valid = 1;
     }
     
+    // 记入当前进程持有的缓冲区数
+    if (curr_proc) {
+        curr_proc->bcache_bufs++;
+    }
     return b;
 }
 
@@ -155,8 +162,16 @@ void brelse(struct buf *b) {
         printf("bio: warning - releasing buffer with refcnt <= 0\n");
         return;
     }
+    if (!holdingsleep(&b->lock)) {
+        printf("bio: warning - releasing buffer not locked by caller\n");
+        return;
+    }
     
+    releasesleep(&b->lock);
     b->refcnt--;
+    if (curr_proc && curr_proc->bcache_bufs > 0) {
+        curr_proc->bcache_bufs--;
+    }
     
     // 如果引用计数为0，移动到LRU链表末尾
     if (b->refcnt == 0) {
@@ -186,3 +201,7 @@ void bunpin(struct buf *b) {
     }
 }
 
+// 块缓存缓冲区个数（供 sys_meminfo 统计）
+int bcache_nbuf(void) {
+    return NBUF;
+}
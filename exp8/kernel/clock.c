@@ -1,12 +1,31 @@
 // kernel/clock.c
 #include "clock.h"
 #include "printf.h"
+#include "proc.h"
 
 #define CLINT_MTIME 0x200BFF8
 #define CLINT_MTIMECMP 0x2004000
 
+#define TW_MASK     (TW_SIZE - 1)
+#define TW_MAXDELTA ((1ULL << (TW_BITS * TW_LEVELS)) - 1)
+
 static uint64_t timer_ticks[NUM_TIMERS] = {0};  //存储三种不同类型定时器的滴答计数数组
 static uint64_t next_event_time = 0;            //下一个定时器事件时间
+
+// 分层时间轮：第 l 层的槽存放距 clk [64^l, 64^(l+1)) 个 tick 内到期的定时器，
+// 第 0 层转完一圈时把上一层的下一个槽重新分配到下层（cascade）
+static struct timer *wheel[TW_LEVELS][TW_SIZE];
+static uint64_t clk = 0;        // 下一个待处理的 tick
+static int pending = 0;         // 轮上的定时器数
+
+// 三个内置周期定时器，代替原来每次中断重算的三个固定间隔；
+// 只做统计，设为可延迟，空闲时不为它们唤醒 CPU
+static struct timer builtin_timers[NUM_TIMERS];
+
+// 调度 tick：有进程竞争时周期性置 need_resched，空闲或只有一个进程时停掉
+static struct timer sched_timer;
+static int tick_on = 0;
+static volatile int need_resched = 0;
   
 // 获取当前时间
 static inline uint64_t read_mtime(void) {
@@ -19,72 +38,226 @@ static inline void write_mtimecmp(uint64_t value) {
     *(volatile uint64_t*)CLINT_MTIMECMP = value;
 }
 
-// 计算下一个事件时间（三个定时器的最小间隔）
-static uint64_t calculate_next_event(void) {
-    uint64_t current_time = read_mtime();
-    uint64_t min_next = (uint64_t)-1;   // 初始化为最大值
-    
-    // 计算三个定时器下一次触发的时间
-    for (int i = 0; i < NUM_TIMERS; i++) {
-        uint64_t interval;
-        switch (i) {
-            case TIMER_FAST:   interval = INTERVAL_FAST; break;
-            case TIMER_MEDIUM: interval = INTERVAL_MEDIUM; break;
-            case TIMER_SLOW:   interval = INTERVAL_SLOW; break;
-            default:           interval = INTERVAL_MEDIUM; break;
+// 按到期时间挂到对应层的槽上
+static void enqueue(struct timer *t) {
+    uint64_t delta = t->expires - clk;
+    struct timer **slot;
+
+    if ((int64_t)delta < 0) {
+        // 已经过期：下一个 tick 处理
+        slot = &wheel[0][clk & TW_MASK];
+    } else {
+        if (delta > TW_MAXDELTA) {
+            t->expires = clk + TW_MAXDELTA;
+            delta = TW_MAXDELTA;
         }
-        
-        // 计算这个定时器下一次应该触发的时间
-        uint64_t next_trigger = ((timer_ticks[i] * interval) / INTERVAL_FAST) * INTERVAL_FAST + interval;
-        uint64_t next_time = current_time + next_trigger;
-        
-        if (next_time < min_next) {
-            min_next = next_time;
+        int lvl = 0;
+        while (delta >= (1ULL << (TW_BITS * (lvl + 1)))) {
+            lvl++;
         }
+        slot = &wheel[lvl][(t->expires >> (TW_BITS * lvl)) & TW_MASK];
     }
-    
-    return min_next;
+    t->next = *slot;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    t->pprev = slot;
+    *slot = t;
+    pending++;
 }
 
-// 检查并更新所有定时器
-static void update_all_timers(void) {
-    uint64_t current_time = read_mtime();
-    
-    // 检查每个定时器是否需要触发
-    for (int i = 0; i < NUM_TIMERS; i++) {
-        uint64_t interval;
-        switch (i) {
-            case TIMER_FAST:   interval = INTERVAL_FAST; break;
-            case TIMER_MEDIUM: interval = INTERVAL_MEDIUM; break;
-            case TIMER_SLOW:   interval = INTERVAL_SLOW; break;
-            default:           interval = INTERVAL_MEDIUM; break;
+static void dequeue(struct timer *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->next = 0;
+    t->pprev = 0;
+    pending--;
+}
+
+// 把第 lvl 层当前槽里的定时器重新分配到下层，返回槽号
+static int cascade(int lvl) {
+    int idx = (clk >> (TW_BITS * lvl)) & TW_MASK;
+    struct timer *t = wheel[lvl][idx];
+
+    wheel[lvl][idx] = 0;
+    while (t) {
+        struct timer *next = t->next;
+        pending--;
+        enqueue(t);
+        t = next;
+    }
+    return idx;
+}
+
+// 处理一个 tick：必要时逐层 cascade，然后执行第 0 层当前槽的定时器
+static void run_one_tick(void) {
+    int idx = clk & TW_MASK;
+    for (int lvl = 1; idx == 0 && lvl < TW_LEVELS; lvl++) {
+        idx = cascade(lvl);
+    }
+    idx = clk & TW_MASK;
+
+    struct timer *t;
+    while ((t = wheel[0][idx]) != 0) {
+        dequeue(t);
+        if (t->period) {
+            t->expires = clk + t->period;   // 周期定时器落在之后的槽，循环必然结束
+            enqueue(t);
         }
-        
-        // 检查是否到了这个定时器的触发时间
-        uint64_t expected_ticks = current_time / interval;
-        if (expected_ticks > timer_ticks[i]) {
-            timer_ticks[i] = expected_ticks;
+        t->fn(t->arg);
+    }
+    clk++;
+}
+
+// 最近的到期 tick；轮上没有定时器时返回 (uint64_t)-1
+// 遍历所有槽，只在重新设置 mtimecmp 时调用一次
+// 调度 tick 关闭时忽略可延迟定时器
+static uint64_t next_expiry(void) {
+    uint64_t best = (uint64_t)-1;
+    if (pending == 0) {
+        return best;
+    }
+    for (int lvl = 0; lvl < TW_LEVELS; lvl++) {
+        for (int i = 0; i < TW_SIZE; i++) {
+            for (struct timer *t = wheel[lvl][i]; t; t = t->next) {
+                if (!tick_on && (t->flags & TIMER_DEFERRABLE)) {
+                    continue;
+                }
+                uint64_t e = (int64_t)(t->expires - clk) < 0 ? clk : t->expires;
+                if (e < best) {
+                    best = e;
+                }
+            }
         }
     }
+    return best;
+}
+
+static void builtin_timer_fn(void *arg) {
+    timer_ticks[(uint64_t)arg]++;
+}
+
+static void sched_timer_fn(void *arg) {
+    (void)arg;
+    need_resched = 1;
+}
+
+// 按最近的到期时间设置 mtimecmp，没有需要唤醒的定时器时不再产生时钟中断
+static void program_next_event(void) {
+    uint64_t next = next_expiry();
+    if (next == (uint64_t)-1) {
+        next_event_time = (uint64_t)-1;
+    } else {
+        next_event_time = next * TICK_CYCLES;
+    }
+    write_mtimecmp(next_event_time);
+}
+
+void timer_setup(struct timer *t, void (*fn)(void *), void *arg) {
+    t->expires = 0;
+    t->period = 0;
+    t->flags = 0;
+    t->fn = fn;
+    t->arg = arg;
+    t->next = 0;
+    t->pprev = 0;
+}
+
+// 从时间轮摘下定时器，返回它之前是否还在轮上
+// 进程上下文修改时间轮时关中断，防止时钟中断重入
+int timer_del(struct timer *t) {
+    push_off();
+    int was_pending = t->pprev != 0;
+    if (was_pending) {
+        dequeue(t);
+    }
+    pop_off();
+    return was_pending;
+}
+
+// delay 个 tick 后到期，period 非 0 时之后每 period 个 tick 再次到期
+void timer_add(struct timer *t, uint64_t delay, uint64_t period) {
+    push_off();
+    if (t->pprev) {
+        dequeue(t);
+    }
+    // 按真实时间计算：动态 tick 下 clk 可能落后，相对 clk 会提前到期
+    t->expires = read_mtime() / TICK_CYCLES + delay;
+    t->period = period;
+    enqueue(t);
+    pop_off();
+}
+
+uint64_t clock_now(void) {
+    return read_mtime() / TICK_CYCLES;
+}
+
+// 动态 tick：调度器在有进程排队时打开，空闲或独占 CPU 时关闭
+void clock_set_tick(int on) {
+    push_off();
+    if (on && !tick_on) {
+        tick_on = 1;
+        timer_add(&sched_timer, SCHED_TICKS, SCHED_TICKS);
+        program_next_event();
+    } else if (!on && tick_on) {
+        tick_on = 0;
+        timer_del(&sched_timer);
+        need_resched = 0;
+        program_next_event();
+    }
+    pop_off();
+}
+
+int clock_need_resched(void) {
+    if (!need_resched) {
+        return 0;
+    }
+    need_resched = 0;
+    return 1;
 }
 
 // 时钟初始化
 void clock_init(void) {
-    uint64_t current_time = read_mtime();
-    next_event_time = current_time + INTERVAL_FAST;  // 从最快定时器开始
-    write_mtimecmp(next_event_time);
+    static const uint64_t intervals[NUM_TIMERS] = {
+        INTERVAL_FAST / TICK_CYCLES,
+        INTERVAL_MEDIUM / TICK_CYCLES,
+        INTERVAL_SLOW / TICK_CYCLES,
+    };
+
+    clk = read_mtime() / TICK_CYCLES;
+    for (int i = 0; i < NUM_TIMERS; i++) {
+        timer_setup(&builtin_timers[i], builtin_timer_fn, (void *)(uint64_t)i);
+        builtin_timers[i].flags = TIMER_DEFERRABLE;
+        timer_add(&builtin_timers[i], intervals[i], intervals[i]);
+    }
+    timer_setup(&sched_timer, sched_timer_fn, 0);
+    // 调度器启动前保持周期 tick，之后由 clock_set_tick 按需开关
+    clock_set_tick(1);
     
-    printf("Clock: initialized with 3 timers\n");
+    printf("Clock: initialized with 3 timers on a %d-level timer wheel\n", TW_LEVELS);
     printf("  Fast:   %d cycles (%d Hz)\n", INTERVAL_FAST, CLOCK_FREQ / INTERVAL_FAST);
     printf("  Medium: %d cycles (%d Hz)\n", INTERVAL_MEDIUM, CLOCK_FREQ / INTERVAL_MEDIUM);
     printf("  Slow:   %d cycles (%d Hz)\n", INTERVAL_SLOW, CLOCK_FREQ / INTERVAL_SLOW);
 }
 
-// 设置下一次时钟中断
+// 时钟中断：推进时间轮到当前时间，执行到期定时器（包括空闲期间错过的可延迟定时器），
+// 再把 mtimecmp 设为最近的到期时间（而不是固定周期）
 void clock_set_next_event(void) {
-    update_all_timers();
-    next_event_time = calculate_next_event();
-    write_mtimecmp(next_event_time);
+    push_off();   // 测试代码也会在进程上下文直接调用
+    uint64_t now = read_mtime() / TICK_CYCLES;
+
+    while (clk <= now) {
+        if (pending == 0) {
+            clk = now + 1;      // 轮是空的，直接跳过空闲的 tick
+            break;
+        }
+        run_one_tick();
+    }
+
+    program_next_event();
+    pop_off();
 }
 
 // 获取指定定时器的ticks
@@ -100,4 +273,29 @@ void reset_ticks(timer_type_t timer) {
     if (timer < NUM_TIMERS) {
         timer_ticks[timer] = 0;
     }
-}
\ No newline at end of file
+}
+
+// 定时睡眠：每个睡眠者有自己的定时器，到期只唤醒它自己
+static void sleep_timer_fn(void *arg) {
+    *(volatile int *)arg = 1;
+    wakeup(arg);
+}
+
+void clock_sleep(uint64_t nticks) {
+    volatile int fired = 0;
+    struct timer t;
+
+    if (!curr_proc) {
+        return;
+    }
+    timer_setup(&t, sleep_timer_fn, (void *)&fired);
+
+    // 检查 fired 与挂入等待队列之间关中断，避免丢失唤醒
+    push_off();
+    timer_add(&t, nticks, 0);
+    while (!fired && !curr_proc->killed) {
+        sleep((void *)&fired);
+    }
+    pop_off();
+    timer_del(&t);
+}
@@ -8,7 +8,8 @@
 void printf_color(int color, const char *fmt, ...) {
     va_list ap;//声明可变参数列表变量ap
     
-    // 设置颜色
+    // 颜色序列与正文作为一个整体发布
+    console_begin();
     set_color(color);
     
     // 解析并输出格式字符串
@@ -95,4 +96,5 @@ void printf_color(int color, const char *fmt, ...) {
     
     // 重置颜色
     set_color(COLOR_RESET);
+    console_end();
 }
\ No newline at end of file
@@ -1,28 +1,173 @@
 #include "types.h"
 #include "console.h"
+#include "proc.h"
 
-// 添加函数声明（如果console.h中没有的话）
-extern void console_putc(char c);
-extern void console_puts(const char *s);
+#include "uart.h"
 
-extern void uart_init(void);
-extern void uart_putc(char c);
-extern void uart_puts(char *s);
+// 控制台输出环：多生产者（各 CPU / 中断上下文）无锁发布整行，UART 发送端是唯一的消费者。
+// 每条记录 = 8 字节头 + 数据，按 8 字节对齐，头部因此不会跨越环尾；数据可以回绕。
+// 生产者用 CAS 推进 head 预留空间，写完数据后置 ready 提交；
+// 消费者只在 tail 处记录已提交时前进，所以各行在环中整行有序，不会交错。
+// 消费者把读过的字节连同记录头全部清零，环中未预留的空间始终为 0：
+// 新记录头落在旧数据上时，提交前读到的 ready 一定是 0。
+#define CONS_RING_SIZE 8192                 // 2 的幂，且是 8 的倍数
+#define CONS_RING_MASK (CONS_RING_SIZE - 1)
+
+struct cons_rec {
+    uint32_t len;                           // 数据长度
+    volatile uint32_t ready;                // 1 表示已提交，消费者读完整条记录后清 0
+};
+
+static struct {
+    char buf[CONS_RING_SIZE] __attribute__((aligned(8)));
+    uint64_t head;                          // 生产者已预留到的位置（单调递增）
+    uint64_t tail;                          // 消费者已读完的记录位置
+    uint32_t off;                           // 消费者在 tail 处记录中已取走的字节数
+    uint32_t dropped;                       // 环满且无法排空时丢弃的行数
+} cons_ring;
+
+static inline uint64_t rec_size(uint32_t len) {
+    return (sizeof(struct cons_rec) + len + 7) & ~7UL;
+}
+
+static inline struct cons_rec* rec_at(uint64_t pos) {
+    return (struct cons_rec*)&cons_ring.buf[pos & CONS_RING_MASK];
+}
+
+// 预留空间并提交一条记录；环满时同步送出积压内容，仍然满就丢弃
+static void ring_publish(const char *s, int len) {
+    uint64_t need = rec_size(len);
+    uint64_t pos = __atomic_load_n(&cons_ring.head, __ATOMIC_RELAXED);
+    int retried = 0;
+
+    for (;;) {
+        uint64_t tail = __atomic_load_n(&cons_ring.tail, __ATOMIC_ACQUIRE);
+        if (pos + need - tail > CONS_RING_SIZE) {
+            if (retried) {
+                __atomic_fetch_add(&cons_ring.dropped, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            retried = 1;
+            uart_tx_kick(1);
+            pos = __atomic_load_n(&cons_ring.head, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&cons_ring.head, &pos, pos + need, 1,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    struct cons_rec *r = rec_at(pos);
+    r->len = len;
+    for (int i = 0; i < len; i++) {
+        cons_ring.buf[(pos + sizeof(*r) + i) & CONS_RING_MASK] = s[i];
+    }
+    __atomic_store_n(&r->ready, 1, __ATOMIC_RELEASE);
+}
+
+// 环排空后补报此前丢弃的行数，报告作为一条记录发布；返回是否发布了报告
+// 环此时为空，ring_publish 不会走到排空发送的路径，可以在消费者里调用
+static int report_dropped(void) {
+    uint32_t n = __atomic_exchange_n(&cons_ring.dropped, 0, __ATOMIC_RELAXED);
+    char buf[48], num[12];
+    int len = 0, i = 0;
+
+    if (n == 0) {
+        return 0;
+    }
+    do {
+        num[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    for (const char *p = "[CONSOLE] dropped "; *p; p++) buf[len++] = *p;
+    while (--i >= 0) buf[len++] = num[i];
+    for (const char *p = " lines\n"; *p; p++) buf[len++] = *p;
+    ring_publish(buf, len);
+    return 1;
+}
+
+// 消费者取一个字节，返回 0 表示没有已提交的输出；调用者持 UART 发送锁，保证只有一个消费者
+int console_tx_getc(char *c) {
+    uint64_t t = cons_ring.tail;
+
+    if (t == __atomic_load_n(&cons_ring.head, __ATOMIC_ACQUIRE) && !report_dropped()) {
+        return 0;
+    }
+    struct cons_rec *r = rec_at(t);
+    if (!__atomic_load_n(&r->ready, __ATOMIC_ACQUIRE)) {
+        return 0;  // 生产者还没写完，由它提交后再启动发送
+    }
+    char *p = &cons_ring.buf[(t + sizeof(*r) + cons_ring.off) & CONS_RING_MASK];
+    *c = *p;
+    *p = 0;
+    if (++cons_ring.off == r->len) {
+        // 对齐填充从未被写过，清掉头部后整条记录都是 0
+        uint64_t size = rec_size(r->len);
+        cons_ring.off = 0;
+        r->len = 0;
+        r->ready = 0;
+        __atomic_store_n(&cons_ring.tail, t + size, __ATOMIC_RELEASE);
+    }
+    return 1;
+}
+
+// 启动发送：中断模式下只填一批 FIFO，其余交给发送空中断
+void console_drain(void) {
+    uart_tx_kick(0);
+}
+
+// 本 CPU 行缓冲中的内容作为一条记录发布
+static void line_flush(struct cpu *c) {
+    if (c->cons_len > 0) {
+        ring_publish(c->cons_line, c->cons_len);
+        c->cons_len = 0;
+    }
+}
+
+// 开始一段输出：关中断后本 CPU 的行缓冲不会被中断上下文插入，可嵌套
+void console_begin(void) {
+    push_off();
+    this_cpu(cons_depth)++;
+}
+
+// 结束一段输出：最外层把剩余的半行也发布出去，恢复中断后启动发送
+void console_end(void) {
+    struct cpu *c = mycpu();
+    int outer = (--c->cons_depth == 0);
+
+    if (outer) {
+        line_flush(c);
+    }
+    pop_off();
+    if (outer) {
+        console_drain();
+    }
+}
 
 // 控制台初始化
 void console_init(void) {
     uart_init();
 }
 
-// 输出一个字符到控制台
-void console_putc(char c) {
-    uart_putc(c);
+// 输出一个字符到控制台：写入本 CPU 行缓冲，遇到换行或缓冲满时整行发布
+void console_putc(char ch) {
+    console_begin();
+    struct cpu *c = mycpu();
+    c->cons_line[c->cons_len++] = ch;
+    if (ch == '\n' || c->cons_len == CONSOLE_LINE) {
+        line_flush(c);
+    }
+    console_end();
 }
 
 // 输出字符串到控制台
 void console_puts(const char *s) {
-    // 需要将const char*转换为char*以兼容现有uart_puts
-    uart_puts((char*)s);
+    console_begin();
+    while (*s) {
+        console_putc(*s++);
+    }
+    console_end();
 }
 
 // 使用ANSI转义序列清屏
@@ -71,10 +216,9 @@ void clear_line(void) {
 //     console_puts("H");
 // }
 
-// 在 console.c 中添加输出同步函数
+// 同步地把环中已提交的输出全部送到 UART
 void console_flush(void) {
-    // 简单的延迟同步
-    for (volatile int i = 0; i < 1000; i++);
+    uart_tx_kick(1);
 }
 
 // 修改 goto_xy 函数，x是列坐标，y是行坐标
@@ -6,6 +6,7 @@
 #include "syscall.h"
 
 #define NFILE 100  // 最大打开文件数
+#define FILEWRITE_OVERHEAD 3  // 每次写事务的非数据块：inode、间接块、非对齐多出的一块
 
 struct {
     struct file file[NFILE];
@@ -63,10 +64,12 @@ int fileread(struct file *f, uint64_t addr, int n) {
     }
     
     if (f->type == FD_INODE) {
+        ilock(f->ip);
         r = readi(f->ip, 1, addr, f->off, n);
         if (r > 0) {
             f->off += r;
         }
+        iunlock(f->ip);
     } else {
         printf("file: read - unsupported file type\n");
         return -1;
@@ -85,16 +88,25 @@ int filewrite(struct file *f, uint64_t addr, int n) {
     }
     
     if (f->type == FD_INODE) {
-        int max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * BSIZE;
+        // 每次按剩余日志空间预留，除去 FILEWRITE_OVERHEAD 个非数据块
+        // （inode、间接块、非对齐写入多出的一块），其余都用来写数据，
+        // 大块顺序写只需提交少数几次。块分配走内存里的 next_free_block，
+        // 没有位图块要写进日志，所以是 3 而不是 xv6 的 4
         i = 0;
         while (i < n) {
-            int n1 = n - i;
-            if (n1 > max) {
-                n1 = max;
+            int want = (n - i + BSIZE - 1) / BSIZE + FILEWRITE_OVERHEAD;
+            int granted = begin_op_n(want);
+            int n1 = (granted - FILEWRITE_OVERHEAD) * BSIZE;
+            if (n1 > n - i) {
+                n1 = n - i;
             }
-            begin_op();
+            ilock(f->ip);
             r = writei(f->ip, 1, addr + i, f->off, n1);
-            end_op();
+            if (r > 0) {
+                f->off += r;
+            }
+            iunlock(f->ip);
+            end_op_n(granted);
             if (r < 0) {
                 break;
             }
@@ -102,7 +114,6 @@ int filewrite(struct file *f, uint64_t addr, int n) {
                 printf("file: write - short write\n");
             }
             i += r;
-            f->off += r;
         }
     } else {
         printf("file: write - unsupported file type\n");
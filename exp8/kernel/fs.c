@@ -53,6 +53,10 @@ static void mkfs(int dev) __attribute__((used));
 
 // 初始化文件系统
 void fsinit(int dev) {
+    for (int i = 0; i < NINODE; i++) {
+        initsleeplock(&icache.inode[i].lock, "inode");
+    }
+
     readsb(dev, &sb);
     if (sb.magic != FS_MAGIC) {
         // 如果文件系统不存在，创建新的
@@ -224,6 +228,24 @@ void iput(struct inode *ip) {
     }
 }
 
+// 锁住inode，必要时从磁盘读入内容；持有期间可以睡眠（读写数据块）
+void ilock(struct inode *ip) {
+    if (ip == 0 || ip->ref < 1) {
+        printf("fs: ilock - invalid inode\n");
+        return;
+    }
+    acquiresleep(&ip->lock);
+    iread(ip);
+}
+
+void iunlock(struct inode *ip) {
+    if (ip == 0 || !holdingsleep(&ip->lock)) {
+        printf("fs: iunlock - inode not locked\n");
+        return;
+    }
+    releasesleep(&ip->lock);
+}
+
 // 解锁并释放inode
 void iunlockput(struct inode *ip) {
     iput(ip);
@@ -258,6 +258,57 @@ void test_filesystem_performance(void) {
     printf("=== Performance test completed ===\n\n");
 }
 
+// 日志预留测试：空闲时一次预留应拿到整个日志区，大块写只提交少数几次
+void test_log_reservation(void) {
+    printf("=== Testing log reservation ===\n");
+
+    int granted = begin_op_n(1000);
+    end_op_n(granted);
+    printf("Idle reservation granted %d blocks (log size %d)\n", granted, log.size);
+    if (granted != log.size - 1) {
+        printf("✗ Log reservation FAILED - expected %d blocks\n", log.size - 1);
+        return;
+    }
+
+    // 按 filewrite 的方式分块写 40 块
+    static char block[BSIZE];
+    for (int i = 0; i < BSIZE; i++) {
+        block[i] = (char)(i % 251);
+    }
+    int nblocks = 40;
+    int before = log.ncommit;
+    int done = 0;
+    struct inode *ip = 0;
+    while (done < nblocks) {
+        int g = begin_op_n(nblocks - done + 3);
+        if (ip == 0) {
+            ip = ialloc(ROOTDEV, T_FILE);
+        }
+        int chunk = g - 3;
+        if (chunk > nblocks - done) {
+            chunk = nblocks - done;
+        }
+        for (int j = 0; j < chunk; j++) {
+            writei(ip, 0, (uint64_t)block, (done + j) * BSIZE, BSIZE);
+        }
+        iupdate(ip);
+        end_op_n(g);
+        done += chunk;
+    }
+    int commits = log.ncommit - before;
+    printf("Wrote %d blocks in %d commits (was %d with 3-block chunks)\n",
+           nblocks, commits, (nblocks + 2) / 3);
+
+    char check[16];
+    readi(ip, 0, (uint64_t)check, (nblocks - 1) * BSIZE, sizeof(check));
+    iput(ip);
+    if (check[5] != block[5] || commits > (nblocks + log.size - 5) / (log.size - 4)) {
+        printf("✗ Log reservation FAILED\n");
+    } else {
+        printf("✓ Log reservation test passed\n");
+    }
+    printf("=== Log reservation test completed ===\n\n");
+}
 
 // 修复后的崩溃恢复测试
 void test_crash_recovery(void) {
@@ -429,6 +480,8 @@ void run_filesystem_tests(void) {
     
     test_filesystem_performance();
     
+    test_log_reservation();
+    
     test_crash_recovery();
     
     printf("========================================\n");
@@ -17,17 +17,6 @@ static void *memcpy_impl(void *dst, const void *src, size_t n) {
     return dst;
 }
 
-// 自旋锁操作
-void acquire(struct spinlock *lk) {
-    while (__sync_lock_test_and_set(&lk->locked, 1)) {
-        // 自旋等待
-    }
-}
-
-void release(struct spinlock *lk) {
-    __sync_lock_release(&lk->locked);
-}
-
 // 初始化日志系统
 void initlog(int dev, struct superblock *sb) {
     if (sizeof(struct logheader) >= BSIZE) {
@@ -38,9 +27,15 @@ void initlog(int dev, struct superblock *sb) {
     log.dev = dev;
     log.start = sb->logstart;
     log.size = sb->nlog;
-    log.lock.locked = 0;
+    if (log.size > LOGSIZE) {
+        printf("log: nlog %d larger than LOGSIZE %d, using %d\n", log.size, LOGSIZE, LOGSIZE);
+        log.size = LOGSIZE;
+    }
+    initlock(&log.lock, "log");
     log.outstanding = 0;
+    log.reserved = 0;
     log.committing = 0;
+    log.ncommit = 0;
     
     recover_from_log();
     
@@ -78,68 +73,76 @@ void recover_from_log(void) {
     // 重置日志状态
     log.lh.n = 0;
     log.outstanding = 0;
+    log.reserved = 0;
     log.committing = 0;
     
     release(&log.lock);
 }
 
-void begin_op(void) {
+// 日志区第一块是日志头，其余块可存放事务数据
+static int log_capacity(void) {
+    return log.size - 1;
+}
+
+// 预留日志空间：至少等到 min(want, MAXOPBLOCKS) 块可用，
+// 然后尽量多给，最多 want 块。返回实际预留的块数，
+// 调用者写入的块数不能超过它，结束时用同一个数调用 end_op_n
+int begin_op_n(int want) {
+    int need = want < MAXOPBLOCKS ? want : MAXOPBLOCKS;
+    int granted;
+
     acquire(&log.lock);
-    
-    // printf("LOG DEBUG: begin_op - before: outstanding=%d, committing=%d\n", 
-    //        log.outstanding, log.committing);
-    
     while (1) {
-        if (log.committing) {
-            // printf("LOG DEBUG: begin_op waiting for commit\n");
-            release(&log.lock);
-            continue;
-        }
-        if (log.lh.n + (log.outstanding + 1) * MAXOPBLOCKS > LOGSIZE) {
-            // printf("LOG DEBUG: begin_op waiting for log space\n");
+        int avail = log_capacity() - log.lh.n - log.reserved;
+        if (log.committing || avail < need) {
+            // 等待提交完成或其他事务结束
             release(&log.lock);
+            acquire(&log.lock);
             continue;
         }
+        granted = want < avail ? want : avail;
+        log.reserved += granted;
         log.outstanding += 1;
-        release(&log.lock);
         break;
     }
+    release(&log.lock);
+    return granted;
+}
 
-    // printf("LOG DEBUG: begin_op - after: outstanding=%d\n", log.outstanding);
+void begin_op(void) {
+    begin_op_n(MAXOPBLOCKS);
 }
 
-void end_op(void) {
+void end_op_n(int granted) {
     int do_commit = 0;
     
     acquire(&log.lock);
     
-    // printf("LOG DEBUG: end_op - before: outstanding=%d, committing=%d, lh.n=%d\n",
-    //        log.outstanding, log.committing, log.lh.n);
-    
     log.outstanding -= 1;
+    log.reserved -= granted;
     if (log.committing) {
-        // printf("LOG ERROR: committing while outstanding operations\n");
+        printf("log: end_op while committing\n");
+        release(&log.lock);
         return;
     }
     if (log.outstanding == 0) {
         do_commit = 1;
         log.committing = 1;
-        // printf("LOG DEBUG: Triggering commit, lh.n=%d\n", log.lh.n);
-    } else {
-        // printf("LOG DEBUG: Not committing yet, outstanding=%d\n", log.outstanding);
     }
     release(&log.lock);
     
     if (do_commit) {
-        // printf("LOG DEBUG: Starting commit process\n");
         commit();
         acquire(&log.lock);
         log.committing = 0;
         release(&log.lock);
-        // printf("LOG DEBUG: Commit complete\n");
     }
 }
 
+void end_op(void) {
+    end_op_n(MAXOPBLOCKS);
+}
+
 // 提交事务
 void commit(void) {
     if (log.lh.n > 0) {
@@ -184,6 +187,7 @@ void commit(void) {
         }
         
         log.lh.n = 0;
+        log.ncommit++;
     }
 }
 
@@ -203,9 +207,9 @@ void log_write(struct buf *b) {
     }
     
     // 检查日志空间
-    if (log.lh.n >= LOGSIZE - MAXOPBLOCKS) {
+    if (log.lh.n >= log_capacity()) {
         printf("log: maximum transaction size exceeded (n=%d, limit=%d)\n", 
-               log.lh.n, LOGSIZE - MAXOPBLOCKS);
+               log.lh.n, log_capacity());
         release(&log.lock);
         return;
     }
@@ -26,6 +26,9 @@ void main(void) {
     // 优先级调度测试
     run_priority_scheduling_tests();
 
+    // 共享内存与 futex
+    test_shm_futex();
+
     printf("=== All Tests Completed ===\n");
     
     while (1) {
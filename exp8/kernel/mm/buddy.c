@@ -1,25 +1,34 @@
-// kernel/mm/buddy.c - 修复碎片合并版本
+// kernel/mm/buddy.c - 物理内存区的伙伴系统后端
 #include "mm.h"
 #include "printf.h"
 #include "buddy.h"
 
-// 伙伴系统全局实例
-static struct buddy_pool buddy_system;
+// 唯一的物理内存区：覆盖 [end, PHYSTOP)
+static struct zone zone_normal;
 
 //将阶数转换为对应的页数：order 0 = 1页，order 1 = 2页，order 8 = 256页
 static inline int order_to_pages(int order) {
     return 1 << order;
 }
 
-// 计算地址在内存池中的页索引
+// 计算地址在内存区中的页索引
 static inline uint64_t addr_to_page_index(uint64_t addr) {
-    if (addr < buddy_system.pool_start) return (uint64_t)-1;
-    return (addr - buddy_system.pool_start) / PAGE_SIZE;
+    if (addr < zone_normal.zone_start) return (uint64_t)-1;
+    return (addr - zone_normal.zone_start) / PAGE_SIZE;
 }
 
 // 计算页索引对应的地址
 static inline uint64_t page_index_to_addr(uint64_t index) {
-    return buddy_system.pool_start + index * PAGE_SIZE;
+    return zone_normal.zone_start + index * PAGE_SIZE;
+}
+
+// 页描述符与页索引互转
+static inline struct page* index_to_page(uint64_t index) {
+    return &zone_normal.mem_map[index];
+}
+
+static inline uint64_t page_to_index(struct page *page) {
+    return (uint64_t)(page - zone_normal.mem_map);
 }
 
 // 获取伙伴块的页索引(异或)
@@ -27,277 +36,258 @@ static inline uint64_t get_buddy_index(uint64_t index, int order) {
     return index ^ (1 << order);
 }
 
-// 检查伙伴块是否空闲且可合并
-int is_buddy_free(uint64_t index, int order) {
-    uint64_t buddy_index = get_buddy_index(index, order);
-    
-    // 检查伙伴索引是否有效
-    if (buddy_index >= buddy_system.total_pages) {
-        printf("Buddy: buddy index %d invalid (total_pages=%d)\n", 
-               (int)buddy_index, (int)buddy_system.total_pages);
-        return 0;
+// 记录块首页的状态与阶数
+void set_buddy_status(uint64_t index, int order, int status) {
+    if (index >= zone_normal.total_pages) {
+        return;
     }
-    
-    // 检查伙伴块是否在对应阶的空闲链表中
-    struct list_head *pos;
-    uint64_t buddy_addr = page_index_to_addr(buddy_index);
-    
-    printf("Buddy: checking if buddy %p (index=%d) is free in order %d\n",
-           (void*)buddy_addr, (int)buddy_index, order);
-    
-    list_for_each(pos, &buddy_system.free_lists[order]) {
-        uint64_t pos_addr = (uint64_t)pos;
-        uint64_t pos_index = addr_to_page_index(pos_addr);
-        
-        printf("Buddy:   comparing with free block %p (index=%d)\n",
-               (void*)pos_addr, (int)pos_index);
-        
-        if (pos_index == buddy_index) {
-            printf("Buddy:   FOUND buddy in free list!\n");
-            return 1;
-        }
+    struct page *page = index_to_page(index);
+    page->order = (uint8_t)order;
+    if (status == BUDDY_FREE) {
+        page->flags |= PG_FREE;
+    } else {
+        page->flags &= ~PG_FREE;
+    }
+}
+
+// 读取块首页状态；阶数不匹配时视为已分配（该页不是此阶空闲块的块首）
+int get_buddy_status(uint64_t index, int order) {
+    if (index >= zone_normal.total_pages) {
+        return BUDDY_ALLOCATED;
+    }
+    struct page *page = index_to_page(index);
+    if ((page->flags & PG_FREE) && page->order == order) {
+        return BUDDY_FREE;
     }
-    
-    printf("Buddy:   buddy NOT found in free list\n");
-    return 0;
+    return BUDDY_ALLOCATED;
+}
+
+// 检查伙伴块是否空闲且可合并 - 查页描述符，O(1)
+int is_buddy_free(uint64_t index, int order) {
+    return get_buddy_status(get_buddy_index(index, order), order) == BUDDY_FREE;
+}
+
+// 把一个空闲块挂到对应阶的空闲链表并登记状态
+static void buddy_push_free(uint64_t index, int order) {
+    struct page *page = index_to_page(index);
+    list_add(&page->list, &zone_normal.free_area[order].free_list);
+    zone_normal.free_area[order].nr_free++;
+    set_buddy_status(index, order, BUDDY_FREE);
+}
+
+// 把一个空闲块从链表摘下
+static void buddy_take_free(uint64_t index, int order) {
+    struct page *page = index_to_page(index);
+    list_del(&page->list);
+    zone_normal.free_area[order].nr_free--;
+    set_buddy_status(index, order, BUDDY_ALLOCATED);
 }
 
-// 完整的伙伴系统初始化
-void buddy_init(void) {
-    printf("Buddy: starting initialization...\n");
-    
+// 内存区初始化：[start, end) 头部存放页描述符数组，其余按最大对齐块放入空闲链表
+void buddy_init(uint64_t start, uint64_t end) {
+    start = PGROUNDUP(start);
+    end = PGROUNDDOWN(end);
+    if (end <= start) {
+        printf("Buddy: ERROR: empty zone [%p, %p)\n", (void*)start, (void*)end);
+        return;
+    }
+
+    // 页描述符数组本身占用的页数：每页需要 PAGE_SIZE + sizeof(struct page) 字节
+    uint64_t span_pages = (end - start) / PAGE_SIZE;
+    uint64_t nr_pages = span_pages * PAGE_SIZE / (PAGE_SIZE + sizeof(struct page));
+    uint64_t map_bytes = PGROUNDUP(nr_pages * sizeof(struct page));
+
+    zone_normal.name = "Normal";
+    zone_normal.mem_map = (struct page*)start;
+    zone_normal.zone_start = start + map_bytes;
+    // map_bytes 向上取整后剩余页数可能多于 nr_pages，而 mem_map 只有 nr_pages 项，
+    // 多出的尾页不纳入管理，否则 mem_map[nr_pages] 会写进区内第一页
+    zone_normal.total_pages = (end - zone_normal.zone_start) / PAGE_SIZE;
+    if (zone_normal.total_pages > nr_pages) {
+        zone_normal.total_pages = nr_pages;
+    }
+    zone_normal.zone_end = zone_normal.zone_start + zone_normal.total_pages * PAGE_SIZE;
+    zone_normal.used_pages = 0;
+
     // 初始化空闲链表
     for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
-        INIT_LIST_HEAD(&buddy_system.free_lists[i]);
+        INIT_LIST_HEAD(&zone_normal.free_area[i].free_list);
+        zone_normal.free_area[i].nr_free = 0;
     }
-    
-    // 设置内存池范围
-    extern char end[];
-    extern uint64_t kernel_base;
-    buddy_system.pool_start = PGROUNDUP((uint64_t)&end);
-    
-    // 使用明确的 PHYSTOP 定义
-    #define BUDDY_PHYSTOP ((uint64_t)kernel_base + 128*1024*1024)
-    buddy_system.pool_size = BUDDY_PHYSTOP - buddy_system.pool_start;
-    buddy_system.total_pages = buddy_system.pool_size / PAGE_SIZE;
-    buddy_system.used_pages = 0;
-    
-    printf("Buddy: pool [%p, %p) size=%dKB, pages=%d\n",
-           (void*)buddy_system.pool_start, 
-           (void*)BUDDY_PHYSTOP,
-           (int)(buddy_system.pool_size / 1024),
-           (int)buddy_system.total_pages);
-    
-    // 暂时禁用位图
-    buddy_system.bitmap = NULL;
-    buddy_system.bitmap_size = 0;
-    
-    // 第一个可用地址就是 pool_start
-    uint64_t data_start = buddy_system.pool_start;
-    
-    // 将整个可用内存作为一个大块添加到最大阶的空闲链表
-    uint64_t available_size = BUDDY_PHYSTOP - data_start;
-    uint64_t available_pages = available_size / PAGE_SIZE;
-    
-    printf("Buddy: available memory: %d pages from %p\n", 
-           (int)available_pages, (void*)data_start);
-    
-    // 找到适合的最大阶数
-    int max_order = BUDDY_MAX_ORDER;
-    while (max_order >= 0) {
-        uint64_t order_pages = order_to_pages(max_order);
-        if (available_pages >= order_pages) {
-            break;
-        }
-        max_order--;
+
+    for (uint64_t i = 0; i < zone_normal.total_pages; i++) {
+        struct page *page = index_to_page(i);
+        INIT_LIST_HEAD(&page->list);
+        page->order = 0;
+        page->flags = 0;
     }
-    
-    if (max_order < 0) {
-        printf("Buddy: ERROR: not enough memory for initialization\n");
-        return;
+
+    // 将整个区切分成尽量大的对齐块
+    uint64_t index = 0;
+    while (index < zone_normal.total_pages) {
+        int order = BUDDY_MAX_ORDER;
+        while (order > 0 &&
+               ((index & (order_to_pages(order) - 1)) != 0 ||
+                index + order_to_pages(order) > zone_normal.total_pages)) {
+            order--;
+        }
+        buddy_push_free(index, order);
+        index += order_to_pages(order);
     }
-    
-    // 将可用内存添加到对应阶的空闲链表
-    struct list_head *block = (struct list_head*)data_start;
-    INIT_LIST_HEAD(block);
-    list_add(block, &buddy_system.free_lists[max_order]);
-    
-    printf("Buddy: initialized with max_order=%d, first block at %p (%d pages)\n", 
-           max_order, (void*)data_start, order_to_pages(max_order));
-    printf("Buddy: initialization completed successfully\n");
+
+    printf("Buddy: zone %s [%p, %p) pages=%d, mem_map=%p (%d pages)\n",
+           zone_normal.name,
+           (void*)zone_normal.zone_start, (void*)zone_normal.zone_end,
+           (int)zone_normal.total_pages,
+           (void*)zone_normal.mem_map, (int)(map_bytes / PAGE_SIZE));
 }
 
-// 修复的分配函数
+// 分配 2^order 个连续页
 void* buddy_alloc(int order) {
     if (order < BUDDY_MIN_ORDER || order > BUDDY_MAX_ORDER) {
         printf("Buddy: invalid order %d\n", order);
         return NULL;
     }
-    
-    printf("Buddy: trying to allocate order %d (%d pages)\n", order, order_to_pages(order));
-    
+
     int current_order = order;
-    
+
     // 寻找合适阶数的空闲块
     while (current_order <= BUDDY_MAX_ORDER) {
-        if (!list_empty(&buddy_system.free_lists[current_order])) {
+        if (!list_empty(&zone_normal.free_area[current_order].free_list)) {
             break;
         }
         current_order++;
     }
-    
+
     if (current_order > BUDDY_MAX_ORDER) {
-        printf("Buddy: out of memory for order %d\n", order);
         return NULL;
     }
-    
-    printf("Buddy: found free block at order %d\n", current_order);
-    
+
     // 从找到的链表中取出第一个块
-    struct list_head *block = buddy_system.free_lists[current_order].next;
-    list_del(block);
-    
-    uint64_t block_addr = (uint64_t)block;
-    uint64_t block_index = addr_to_page_index(block_addr);
-    
-    printf("Buddy: got block at %p (index=%d) from order %d\n", 
-           (void*)block_addr, (int)block_index, current_order);
-    
-    // 如果找到的块比需要的大，进行分裂
+    struct page *page = (struct page*)zone_normal.free_area[current_order].free_list.next;
+    uint64_t block_index = page_to_index(page);
+    buddy_take_free(block_index, current_order);
+
+    // 如果找到的块比需要的大，进行分裂，后半部分作为伙伴放回低一阶的链表
     while (current_order > order) {
         current_order--;
-        
-        // 计算伙伴块
-        uint64_t buddy_index = get_buddy_index(block_index, current_order);
-        uint64_t buddy_addr = page_index_to_addr(buddy_index);
-        
-        // 检查伙伴索引是否有效
-        if (buddy_index >= buddy_system.total_pages) {
-            printf("Buddy: WARNING: invalid buddy index %d, stopping split\n", (int)buddy_index);
-            break;
-        }
-        
-        printf("Buddy: splitting order %d -> %d\n", current_order + 1, current_order);
-        printf("Buddy: block=%p (index=%d), buddy=%p (index=%d)\n", 
-               (void*)block_addr, (int)block_index, (void*)buddy_addr, (int)buddy_index);
-        
-        // 将伙伴块添加到对应阶的空闲链表
-        struct list_head *buddy = (struct list_head*)buddy_addr;
-        INIT_LIST_HEAD(buddy);
-        list_add(buddy, &buddy_system.free_lists[current_order]);
-        
-        printf("Buddy: added buddy block to free list order %d\n", current_order);
+        buddy_push_free(get_buddy_index(block_index, current_order), current_order);
     }
-    
-    buddy_system.used_pages += order_to_pages(order);
-    
-    printf("Buddy: allocated order %d at %p (index=%d), pages=%d\n",
-           order, (void*)block_addr, (int)block_index, order_to_pages(order));
-    
-    return (void*)block_addr;
+
+    set_buddy_status(block_index, order, BUDDY_ALLOCATED);
+    zone_normal.used_pages += order_to_pages(order);
+
+    return (void*)page_index_to_addr(block_index);
 }
 
-// 修复的释放函数 - 改进合并逻辑
+// 释放 2^order 个连续页，并与空闲伙伴逐级合并
 void buddy_free(void* addr, int order) {
     if (addr == NULL || order < BUDDY_MIN_ORDER || order > BUDDY_MAX_ORDER) {
         printf("Buddy: invalid free parameters: addr=%p, order=%d\n", addr, order);
         return;
     }
-    
-    uint64_t block_addr = (uint64_t)addr;
-    uint64_t current_index = addr_to_page_index(block_addr);
-    
-    printf("Buddy: freeing order %d at %p (index=%d)\n", order, addr, (int)current_index);
-    
+
+    uint64_t current_index = addr_to_page_index((uint64_t)addr);
+
     // 验证地址有效性
-    if (current_index >= buddy_system.total_pages) {
-        printf("Buddy: ERROR: invalid address %p (index=%d, total_pages=%d)\n", 
-               addr, (int)current_index, (int)buddy_system.total_pages);
+    if (current_index >= zone_normal.total_pages ||
+        (current_index & (order_to_pages(order) - 1)) != 0) {
+        printf("Buddy: ERROR: invalid address %p (index=%d, order=%d)\n",
+               addr, (int)current_index, order);
+        return;
+    }
+
+    if (index_to_page(current_index)->flags & PG_FREE) {
+        printf("Buddy: ERROR: double free at %p\n", addr);
         return;
     }
-    
+
     int current_order = order;
     uint64_t merge_index = current_index;
-    uint64_t merge_addr = block_addr;
-    
+
     // 只要当前阶数小于最大阶数，就尝试合并
     while (current_order < BUDDY_MAX_ORDER) {
         uint64_t buddy_index = get_buddy_index(merge_index, current_order);
-        
-        // 检查伙伴索引是否有效
-        if (buddy_index >= buddy_system.total_pages) {
-            printf("Buddy: buddy index %d exceeds total pages %d, stop merging\n",
-                   (int)buddy_index, (int)buddy_system.total_pages);
-            break;
-        }
-        
-        printf("Buddy: checking merge at order %d, index=%d, buddy_index=%d\n",
-               current_order, (int)merge_index, (int)buddy_index);
-        
+
         // 检查伙伴块是否空闲且可合并
         if (!is_buddy_free(merge_index, current_order)) {
-            printf("Buddy: buddy not free, stop merging at order %d\n", current_order);
             break;
         }
-        
-        uint64_t buddy_addr = page_index_to_addr(buddy_index);
-        
-        printf("Buddy: merging at order %d: block=%p, buddy=%p\n",
-               current_order, (void*)merge_addr, (void*)buddy_addr);
-        
+
         // 从空闲链表中移除伙伴块
-        struct list_head *buddy = (struct list_head*)buddy_addr;
-        list_del(buddy);
-        
-        // 计算合并后的块地址（取两个块中较小的地址）
+        buddy_take_free(buddy_index, current_order);
+
+        // 合并后的块取两个块中较小的索引
         if (buddy_index < merge_index) {
             merge_index = buddy_index;
-            merge_addr = buddy_addr;
         }
-        
+
         current_order++;
-        
-        printf("Buddy: merged order %d -> %d at %p (index=%d)\n",
-               current_order - 1, current_order, (void*)merge_addr, (int)merge_index);
     }
-    
+
     // 将合并后的块添加到对应阶的空闲链表
-    struct list_head *block = (struct list_head*)merge_addr;
-    INIT_LIST_HEAD(block);
-    list_add(block, &buddy_system.free_lists[current_order]);
-    
-    buddy_system.used_pages -= order_to_pages(order);
-    
-    printf("Buddy: freed order %d, final order=%d at %p\n", 
-           order, current_order, (void*)merge_addr);
+    buddy_push_free(merge_index, current_order);
+
+    zone_normal.used_pages -= order_to_pages(order);
+}
+
+// 释放任意页数的连续区间：拆成尽量大的对齐块逐个归还
+void buddy_free_range(void* addr, int count) {
+    uint64_t index = addr_to_page_index((uint64_t)addr);
+
+    while (count > 0) {
+        int order = BUDDY_MAX_ORDER;
+        while (order > 0 &&
+               ((index & (order_to_pages(order) - 1)) != 0 ||
+                order_to_pages(order) > count)) {
+            order--;
+        }
+        buddy_free((void*)page_index_to_addr(index), order);
+        index += order_to_pages(order);
+        count -= order_to_pages(order);
+    }
+}
+
+// 判断地址是否属于内存区的可分配部分
+int buddy_owns(void* addr) {
+    uint64_t a = (uint64_t)addr;
+    return a >= zone_normal.zone_start && a < zone_normal.zone_end;
 }
 
-// 简化的伙伴系统状态转储
+// 伙伴系统状态转储：直接读取各阶计数
 void buddy_dump(void) {
     printf("=== Buddy System Status ===\n");
-    printf("Pool: [%p, %p) total_pages=%d, used_pages=%d\n",
-           (void*)buddy_system.pool_start, 
-           (void*)(buddy_system.pool_start + buddy_system.pool_size),
-           (int)buddy_system.total_pages, (int)buddy_system.used_pages);
-    
+    printf("Zone %s: [%p, %p) total_pages=%d, used_pages=%d\n",
+           zone_normal.name,
+           (void*)zone_normal.zone_start, (void*)zone_normal.zone_end,
+           (int)zone_normal.total_pages, (int)zone_normal.used_pages);
+
     for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
-        int count = 0;
-        struct list_head *pos;
-        list_for_each(pos, &buddy_system.free_lists[i]) {
-            count++;
-        }
-        printf("Order %d (%d pages): %d free blocks\n", 
-               i, order_to_pages(i), count);
+        printf("Order %d (%d pages): %d free blocks\n",
+               i, order_to_pages(i), (int)zone_normal.free_area[i].nr_free);
     }
     printf("===========================\n");
 }
 
 // 获取总页数
 uint64_t buddy_get_total_pages(void) {
-    return buddy_system.total_pages;
+    return zone_normal.total_pages;
 }
 
 // 获取已使用页数
 uint64_t buddy_get_used_pages(void) {
-    return buddy_system.used_pages;
-}
\ No newline at end of file
+    return zone_normal.used_pages;
+}
+
+// 复制各阶空闲块数量，返回空闲页总数；只读计数器，O(阶数)
+uint64_t buddy_get_free_blocks(uint64_t *nr_free) {
+    uint64_t free = 0;
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        uint64_t n = zone_normal.free_area[i].nr_free;
+        if (nr_free) {
+            nr_free[i] = n;
+        }
+        free += n << i;
+    }
+    return free;
+}
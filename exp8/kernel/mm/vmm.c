@@ -2,6 +2,7 @@
 #include "mm.h"
 #include "printf.h"
 #include "console.h"
+#include "proc.h"
 
 // 内联的简单内存设置函数 - 使用 uint64_t 替代 size_t
 // 将指定内存区域填充为特定值
@@ -12,6 +13,17 @@ static inline void simple_memset(void* dst, char value, uint64_t n) {
     }
 }
 
+// 已分配的页表页数量（供 sys_meminfo 统计）
+uint64_t pagetable_pages = 0;
+
+// 页表所属进程：只有进程私有的页表才计入进程内存统计，共享的内核页表不计
+static struct proc* vm_owner(pagetable_t pt) {
+    if (curr_proc && pt != kernel_pagetable && curr_proc->pagetable == pt) {
+        return curr_proc;
+    }
+    return NULL;
+}
+
 //遍历页表，为虚拟地址创建或查找对应的页表项。
 static pte_t* walk_create(pagetable_t pt, uint64_t va, int alloc) {
     pagetable_t current_pt = pt;
@@ -31,6 +43,10 @@ static pte_t* walk_create(pagetable_t pt, uint64_t va, int alloc) {
                 return NULL;
                 
             simple_memset(new_pt, 0, PAGE_SIZE);// 清零新页表
+            pagetable_pages++;
+            struct proc *owner = vm_owner(pt);
+            if(owner)
+                owner->pt_pages++;
             *pte = ((uint64_t)new_pt >> 12) <<10| PTE_V;// 设置PTE
             current_pt = new_pt;// 进入新创建的页表
         }
@@ -44,6 +60,7 @@ pagetable_t create_pagetable(void) {
     pagetable_t pt = alloc_page();
     if(pt) {
         simple_memset(pt, 0, PAGE_SIZE);
+        pagetable_pages++;
     }
     return pt;
 }
@@ -61,6 +78,9 @@ int map_page(pagetable_t pt, uint64_t va, uint64_t pa, int perm) {
         return -1;
 
     *pte = (pa >> 12)<<10 | perm | PTE_V;//物理地址右移12位（物理地址有12位offset，PTE中物理页号后面还有10位）
+    struct proc *owner = vm_owner(pt);
+    if(owner && (perm & PTE_U))
+        owner->user_pages++;
     return 0;
 }
 
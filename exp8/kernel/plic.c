@@ -0,0 +1,32 @@
+// kernel/plic.c - PLIC 外部中断路由
+#include "types.h"
+#include "plic.h"
+#include "proc.h"
+#include "printf.h"
+
+static inline void plic_write(uint64_t addr, uint32_t val) {
+    *(volatile uint32_t *)addr = val;
+}
+
+static inline uint32_t plic_read(uint64_t addr) {
+    return *(volatile uint32_t *)addr;
+}
+
+void plic_init(void) {
+    int hart = cpuid();
+
+    // 优先级为 0 的中断源不会被送达
+    plic_write(PLIC_PRIORITY(UART0_IRQ), 1);
+    plic_write(PLIC_MENABLE(hart), 1 << UART0_IRQ);
+    plic_write(PLIC_MTHRESHOLD(hart), 0);
+
+    printf("PLIC: UART0 irq %d routed to hart %d\n", UART0_IRQ, hart);
+}
+
+int plic_claim(void) {
+    return plic_read(PLIC_MCLAIM(cpuid()));
+}
+
+void plic_complete(int irq) {
+    plic_write(PLIC_MCLAIM(cpuid()), irq);
+}
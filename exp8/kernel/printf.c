@@ -74,6 +74,8 @@ int printf(const char *fmt, ...) {
         return 0;
     }
 
+    // 整条消息先在本 CPU 行缓冲中成形，再按行发布到控制台输出环，多处并发打印不会交错
+    console_begin();
     va_start(ap, fmt);
 
     for(i = 0; (c = fmt[i]) != '\0'; i++) {
@@ -235,5 +237,6 @@ int printf(const char *fmt, ...) {
             repeat_count = 0;
         }
     }
+    console_end();
     return 0;
 }
\ No newline at end of file
@@ -45,14 +45,14 @@ int set_nice(int pid, int nice) {
     
 static int has_runnable_process(void) {
     int runnable = 0;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state == RUNNABLE) {
             runnable = 1;
                     break;
                 }
             }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return runnable;
 }
 
@@ -65,7 +65,7 @@ void priority_scheduler(void) {
 
 void show_priority_info(void) {
     printf("\n=== Priority Scheduling Snapshot ===\n");
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         struct proc *p = &proc[i];
         if (p->state == UNUSED) {
@@ -75,7 +75,7 @@ void show_priority_info(void) {
                p->pid, p->state, p->priority, p->queue_level, p->queue_ticks,
                p->ticks, p->wait_time);
         }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     printf("====================================\n");
 }
 
@@ -35,14 +35,14 @@ static void cleanup_all_processes(void) {
 
 static int has_runnable_process(void) {
     int active = 0;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state == RUNNABLE) {
             active = 1;
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return active;
 }
 
@@ -79,14 +79,14 @@ static void print_completion(const char *tag, const struct completion_log *log)
 
 static int snapshot_ticks(int pid) {
     int ticks = -1;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].pid == pid) {
             ticks = proc[i].ticks;
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return ticks;
 }
 
@@ -221,27 +221,27 @@ static void test_equal_priority_rr(void) {
 // 辅助函数：获取进程的 priority 和 queue_level
 static int get_proc_priority(int pid) {
     int result = -1;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].pid == pid) {
             result = proc[i].priority;
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return result;
 }
 
 static int get_proc_queue_level(int pid) {
     int result = -1;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].pid == pid) {
             result = proc[i].queue_level;
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return result;
 }
 
@@ -282,7 +282,7 @@ static void test_aging_prevents_starvation(void) {
     for (int i = 0; i < 12; i++) {
         scheduler();
         // 检查低优先级任务的 wait_time（用于调试）
-        spin_lock(&proc_lock);
+        acquire(&proc_lock);
         int low1_wait = -1, low2_wait = -1;
         for (int j = 0; j < NPROC; j++) {
             if (proc[j].pid == low1) {
@@ -292,7 +292,7 @@ static void test_aging_prevents_starvation(void) {
                 low2_wait = proc[j].wait_time;
             }
         }
-        spin_unlock(&proc_lock);
+        release(&proc_lock);
         if (i % 3 == 0) {
             printf("    调度 %d: low1 wait_time=%d, low2 wait_time=%d\n", i, low1_wait, low2_wait);
         }
@@ -4,6 +4,7 @@
 #include "trap.h"
 #include "clock.h"
 #include "priority.h"
+#include "shm.h"
 
 // 简易关机：QEMU virt/sifive 测试器（finisher），若存在则可用于退出仿真
 #define QEMU_FINISHER_ADDR 0x100000UL
@@ -19,9 +20,8 @@ static inline void qemu_poweroff_success(void) {
 extern void context_switch(struct context *old, struct context *new);
 
 struct proc proc[NPROC];
-struct proc *curr_proc = 0;
+struct cpu cpus[NCPU];   // 当前进程、调度器上下文等都在这里，经 tp 访问
 static int next_pid = 1;
-static struct context scheduler_context; // 调度器自身的上下文
 
 static void reset_accounting(struct proc *p);
 static void age_runnable_processes(void);
@@ -39,16 +39,7 @@ static const int mlfq_level_priorities[MLFQ_LEVELS] = {
     PRIORITY_MIN + 2
 };
 
-// 简单的自旋锁
-inline void spin_lock(volatile int *lock) {
-    while (__sync_lock_test_and_set(lock, 1)) {}// 原子测试并设置
-}
-
-inline void spin_unlock(volatile int *lock) {
-    __sync_lock_release(lock);// 原子释放锁
-}
-
-volatile int proc_lock = 0;// 进程表锁
+struct spinlock proc_lock;// 进程表锁
 
 // 调度器循环函数
 void scheduler_loop(void) {
@@ -65,6 +56,8 @@ void scheduler_loop(void) {
 // 进程初始化
 void proc_init(void) {
     printf("Process: initializing process table with %d slots\n", NPROC);
+    initlock(&proc_lock, "proc");
+    shm_init();
     
     for (int i = 0; i < NPROC; i++) {
         proc[i].state = UNUSED;
@@ -85,8 +78,8 @@ void proc_init(void) {
     }
 
     // 正确初始化调度器上下文
-    scheduler_context.ra = (uint64_t)scheduler_loop;
-    scheduler_context.sp = (uint64_t)alloc_page() + PAGE_SIZE;  // 分配调度器栈
+    mycpu()->scheduler.ra = (uint64_t)scheduler_loop;
+    mycpu()->scheduler.sp = (uint64_t)alloc_page() + PAGE_SIZE;  // 分配调度器栈
     
     printf("Process: process table initialized\n");
 }
@@ -190,7 +183,7 @@ static struct proc* select_highest_priority(void) {
 
 // 分配进程结构
 struct proc* alloc_proc(void) {
-    spin_lock(&proc_lock);// 加锁保护进程表
+    acquire(&proc_lock);// 加锁保护进程表
     
     struct proc *p = 0;
     // 查找空闲进程槽
@@ -205,7 +198,7 @@ struct proc* alloc_proc(void) {
         // 分配内核栈
         void *stack = alloc_page();
         if (!stack) {
-            spin_unlock(&proc_lock);
+            release(&proc_lock);
             printf("Process: failed to allocate stack for new process\n");
             return NULL;
         }
@@ -214,6 +207,11 @@ struct proc* alloc_proc(void) {
         p->pid = next_pid++;
         p->kstack = (uint64_t)stack;
         p->pagetable = kernel_pagetable;
+        p->sz = 0;
+        p->user_pages = 0;
+        p->pt_pages = 0;
+        p->kstack_pages = 1;
+        p->bcache_bufs = 0;
         p->parent = curr_proc;
         p->killed = 0;
         p->xstate = 0;
@@ -260,7 +258,7 @@ struct proc* alloc_proc(void) {
         printf("Process: process table full, cannot allocate new process\n");
     }
     
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return p;
 }
 
@@ -297,6 +295,7 @@ int create_process(void (*entry)(void)) {
     // 设置为可运行状态
     p->state = RUNNABLE;
     reset_accounting(p);
+    sched_kick();
     
     printf("Process: created process %d, entry=%p, stack=%p\n", 
            p->pid, (void*)entry, (void*)stack_top);
@@ -316,6 +315,9 @@ void exit_process(int status) {
     curr_proc->xstate = status;
     curr_proc->state = ZOMBIE;
     curr_proc->killed = 0;
+
+    // 解除共享内存挂接，最后一个挂接者负责释放段
+    shm_release(curr_proc);
     
     if (curr_proc->parent) {
         wakeup(curr_proc->parent);
@@ -325,7 +327,7 @@ void exit_process(int status) {
     curr_proc = 0;
     
     // 切换到调度器上下文，调度器负责选择新的运行进程
-    context_switch(&p->context, &scheduler_context);
+    context_switch(&p->context, &mycpu()->scheduler);
     
     // 不应该返回
     printf("PANIC: exit_process returned after context switch\n");
@@ -344,7 +346,7 @@ int wait_process(int *status) {
         struct proc *p;
         int found = 0;
         
-        spin_lock(&proc_lock);
+        acquire(&proc_lock);
         for (int i = 0; i < NPROC; i++) {
             p = &proc[i];
             if (p->state == ZOMBIE) {
@@ -353,7 +355,7 @@ int wait_process(int *status) {
                 break;
             }
         }
-        spin_unlock(&proc_lock);
+        release(&proc_lock);
         
         if (found) {
             if (status) {
@@ -364,6 +366,8 @@ int wait_process(int *status) {
             p->state = UNUSED;
             if (p->kstack) {
                 free_page((void*)p->kstack);
+                p->kstack = 0;
+                p->kstack_pages = 0;
             }
             
             printf("Process: reaped zombie process %d\n", p->pid);
@@ -379,7 +383,7 @@ int wait_process(int *status) {
         int found = 0;
         struct proc *p;
         
-        spin_lock(&proc_lock);
+        acquire(&proc_lock);
         // 查找僵尸状态的子进程
         for (int i = 0; i < NPROC; i++) {
             p = &proc[i];
@@ -389,7 +393,7 @@ int wait_process(int *status) {
                 break;
             }
         }
-        spin_unlock(&proc_lock);
+        release(&proc_lock);
         
         if (found) {
             if (status) {
@@ -400,6 +404,8 @@ int wait_process(int *status) {
             p->state = UNUSED;
             if (p->kstack) {
                 free_page((void*)p->kstack);
+                p->kstack = 0;
+                p->kstack_pages = 0;
             }
             
             printf("Process: reaped process %d with status %d\n", p->pid, p->xstate);
@@ -413,31 +419,97 @@ int wait_process(int *status) {
     }
 }
 
+// 等待队列：按通道地址哈希，睡眠进程挂在对应的桶上，
+// 唤醒时只遍历该桶而不是整个进程表；由 proc_lock 保护
+#define WAITQ_BUCKETS 32
+static struct proc *waitq[WAITQ_BUCKETS];
+
+static inline struct proc** waitq_bucket(void *chan) {
+    uint64_t a = (uint64_t)chan;
+    return &waitq[((a >> 3) ^ (a >> 11)) & (WAITQ_BUCKETS - 1)];
+}
+
+// 从桶中摘除进程，调用者持有 proc_lock
+static void waitq_unlink(struct proc *p) {
+    struct proc **pp = waitq_bucket(p->chan);
+    while (*pp) {
+        if (*pp == p) {
+            *pp = p->wait_next;
+            break;
+        }
+        pp = &(*pp)->wait_next;
+    }
+    p->wait_next = 0;
+    p->on_waitq = 0;
+}
+
 // 简单的睡眠/唤醒机制
 void sleep(void *chan) {
     if (!curr_proc) return;
     
+    acquire(&proc_lock);
+    struct proc **bucket = waitq_bucket(chan);
     curr_proc->chan = chan;
     curr_proc->state = SLEEPING;
     curr_proc->queue_ticks = 0;
     curr_proc->wait_time = 0;
+    curr_proc->wait_next = *bucket;
+    curr_proc->on_waitq = 1;
+    *bucket = curr_proc;
+    release(&proc_lock);
+
     yield();//让出CPU
+
+    // 被 kill 等其他路径唤醒时可能仍在队列上
+    acquire(&proc_lock);
+    if (curr_proc->on_waitq) {
+        waitq_unlink(curr_proc);
+    }
+    curr_proc->chan = 0;
+    release(&proc_lock);
 }
 
-void wakeup(void *chan) {
-    spin_lock(&proc_lock);
-    
-    // 唤醒所有在指定通道上睡眠的进程
-    for (int i = 0; i < NPROC; i++) {
-        if (proc[i].state == SLEEPING && proc[i].chan == chan) {
-            proc[i].state = RUNNABLE;
-            proc[i].chan = 0;
-            proc[i].wait_time = 0;
-            proc[i].queue_ticks = 0;
+// 唤醒通道上的睡眠进程，max 为最多唤醒个数（<=0 表示全部），返回唤醒个数
+static int wakeup_common(void *chan, int max) {
+    int woken = 0;
+
+    acquire(&proc_lock);
+    struct proc **pp = waitq_bucket(chan);
+    while (*pp) {
+        struct proc *p = *pp;
+        if (p->chan != chan || p->state != SLEEPING) {
+            pp = &p->wait_next;
+            continue;
+        }
+        *pp = p->wait_next;
+        p->wait_next = 0;
+        p->on_waitq = 0;
+        p->state = RUNNABLE;
+        p->chan = 0;
+        p->wait_time = 0;
+        p->queue_ticks = 0;
+        if (++woken == max) {
+            break;
         }
     }
-    
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
+    sched_kick();
+    return woken;
+}
+
+// 唤醒所有在指定通道上睡眠的进程
+void wakeup(void *chan) {
+    wakeup_common(chan, 0);
+}
+
+// 只唤醒一个睡眠进程，避免惊群
+void wakeup_one(void *chan) {
+    wakeup_common(chan, 1);
+}
+
+// 最多唤醒 n 个睡眠进程，返回实际唤醒个数（futex_wake 使用）
+int wakeup_n(void *chan, int n) {
+    return wakeup_common(chan, n);
 }
 
 int proc_set_priority(int pid, int priority) {
@@ -445,7 +517,7 @@ int proc_set_priority(int pid, int priority) {
         return -1;
     }
     
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     struct proc *target = NULL;
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state != UNUSED && proc[i].pid == pid) {
@@ -455,7 +527,7 @@ int proc_set_priority(int pid, int priority) {
     }
     
     if (!target) {
-        spin_unlock(&proc_lock);
+        release(&proc_lock);
         return -2;
     }
     
@@ -464,20 +536,20 @@ int proc_set_priority(int pid, int priority) {
     target->queue_ticks = 0;
     target->wait_time = 0;
     mlfq_apply_level(target);
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return 0;
 }
 
 int proc_get_priority(int pid) {
     int result = -1;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state != UNUSED && proc[i].pid == pid) {
             result = proc[i].priority;
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     return result;
 }
 
@@ -495,6 +567,33 @@ void yield(void) {
     scheduler();
 }
 
+// 出现了新的就绪进程：若当前有进程在运行，恢复调度 tick 以便抢占它
+void sched_kick(void) {
+    if (curr_proc) {
+        clock_set_tick(1);
+    }
+}
+
+// 恢复进入 scheduler() 时保存的 push_off 状态
+static void sched_restore_intr(int noff, int intena) {
+    struct cpu *c = mycpu();
+    if (noff > 0) {
+        intr_off();
+    }
+    c->noff = noff;
+    c->intena = intena;
+}
+
+// 除正在运行的进程外还有没有就绪进程，调用者持有 proc_lock
+static int runnable_waiting(void) {
+    for (int i = 0; i < NPROC; i++) {
+        if (proc[i].state == RUNNABLE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 void scheduler(void) {
     static int scheduler_started_logged = 0;
 
@@ -503,12 +602,30 @@ void scheduler(void) {
         scheduler_started_logged = 1;
     }
     
-    // 开启中断
-    asm volatile("csrs mstatus, %0" : : "r" (1 << 3));
+    // 调用者（如 sleeplock）可能处于 push_off 中：保存它的关中断状态，
+    // 调度期间开中断，返回或切换回来时再恢复
+    struct cpu *c = mycpu();
+    int noff = c->noff;
+    int intena = c->intena;
+    c->noff = 0;
+    intr_on();
     
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     age_runnable_processes();
     struct proc *p = select_highest_priority();
+
+    // 调用者在睡眠而没有别的进程可运行：返回只会让它的睡眠循环空转，
+    // 在这里等中断把它（或别的进程）唤醒。关中断执行 wfi，有中断挂起
+    // 时照样返回，pop_off 开中断后才处理，唤醒不会落在检查与 wfi 之间
+    while (!p && curr_proc && curr_proc->state == SLEEPING) {
+        clock_set_tick(0);
+        push_off();
+        release(&proc_lock);
+        asm volatile("wfi");
+        pop_off();
+        acquire(&proc_lock);
+        p = select_highest_priority();
+    }
     
     if (p) {
         printf("Scheduler: switching to process %d (priority=%d, wait=%d, ticks=%d)\n",
@@ -522,16 +639,19 @@ void scheduler(void) {
         struct proc *prev_proc = curr_proc;
         curr_proc = p;
         
-        spin_unlock(&proc_lock);
+        // 动态 tick：只有还有别的进程排队时才需要周期性抢占
+        clock_set_tick(runnable_waiting());
+        release(&proc_lock);
         
         // 上下文切换
+        this_cpu(nswitch)++;
         if (prev_proc) {
             printf("  Switching from process %d to %d\n", prev_proc->pid, p->pid);
             context_switch(&prev_proc->context, &p->context);
         } else {
             // 第一次调度或从退出进程切换
             printf("  Switching from scheduler to process %d\n", p->pid);
-            context_switch(&scheduler_context, &p->context);
+            context_switch(&c->scheduler, &p->context);
         }
         
         // 切换回来后
@@ -540,27 +660,30 @@ void scheduler(void) {
         } else {
             printf("Scheduler: returned with no current process\n");
         }
+        sched_restore_intr(noff, intena);
         return;
     }
 
-    // 没有可运行进程
-    spin_unlock(&proc_lock);
+    // 没有可运行进程：停掉调度 tick，mtimecmp 只按最近的定时器设置
+    clock_set_tick(0);
+    release(&proc_lock);
     printf("Scheduler: no runnable processes found\n");
     
     // 检查是否有僵尸进程需要清理
     int zombie_count = 0;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state == ZOMBIE) {
             zombie_count++;
             printf("  Found zombie process %d\n", proc[i].pid);
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     
     if (zombie_count > 0) {
         printf("Scheduler: %d zombie processes waiting to be reaped\n", zombie_count);
     }
+    sched_restore_intr(noff, intena);
 }
 
 // 简单测试任务
@@ -600,7 +723,9 @@ void cpu_intensive_task(void) {
 static int buffer[BUFFER_SIZE];
 static int count = 0;
 static int in = 0, out = 0;
-static void *buffer_chan = (void*)0x1234;
+// 两个条件分开等待，wakeup_one 才不会唤醒同类进程
+static int buffer_not_full;
+static int buffer_not_empty;
 
 // 共享缓冲区初始化函数
 void shared_buffer_init(void) {
@@ -614,7 +739,7 @@ void producer_task(void) {
     for (int i = 0; i < 5; i++) {
         // 等待缓冲区有空位
         while (count == BUFFER_SIZE) {
-            sleep(buffer_chan);
+            sleep(&buffer_not_full);
         }
         
         // 生产项目
@@ -624,8 +749,8 @@ void producer_task(void) {
         
         printf("Process %d: produced item %d\n", curr_proc->pid, i);
         
-        // 唤醒消费者
-        wakeup(buffer_chan);
+        // 唤醒一个消费者
+        wakeup_one(&buffer_not_empty);
         
         // 延时
         for (volatile int j = 0; j < 500000; j++);
@@ -641,7 +766,7 @@ void consumer_task(void) {
     for (int i = 0; i < 5; i++) {
         // 等待缓冲区有数据
         while (count == 0) {
-            sleep(buffer_chan);
+            sleep(&buffer_not_empty);
         }
         
         // 消费项目
@@ -651,8 +776,8 @@ void consumer_task(void) {
         
         printf("Process %d: consumed item %d\n", curr_proc->pid, item);
         
-        // 唤醒生产者
-        wakeup(buffer_chan);
+        // 唤醒一个生产者
+        wakeup_one(&buffer_not_full);
         
         // 延时
         for (volatile int j = 0; j < 500000; j++);
@@ -0,0 +1,234 @@
+// kernel/shm.c - 共享内存段与 futex 等待/唤醒
+#include "shm.h"
+#include "proc.h"
+#include "mm.h"
+#include "spinlock.h"
+#include "syscall.h"
+#include "printf.h"
+
+struct shm_seg {
+    int used;
+    int key;            // 0 表示私有段，不参与按 key 查找
+    int npages;
+    char *base;         // alloc_pages 得到的连续物理页
+    int refs;           // 所有进程的挂接次数之和
+    int removed;        // 已 shm_remove：不再按 key/段号找到，最后一个挂接者解除时释放
+};
+
+// 段表与挂接计数由 shm_lock 保护
+static struct spinlock shm_lock;
+static struct shm_seg segs[NSHM];
+static int attached[NPROC][NSHM];   // 每个进程槽对每个段的挂接次数
+
+void shm_init(void) {
+    initlock(&shm_lock, "shm");
+}
+
+int shm_get(int key, int size) {
+    if (key < 0 || size <= 0 || size > SHM_MAX_PAGES * PAGE_SIZE) {
+        return SYSERR_INVALID_ARGS;
+    }
+    int npages = PGROUNDUP(size) / PAGE_SIZE;
+
+    acquire(&shm_lock);
+    if (key != SHM_PRIVATE) {
+        for (int i = 0; i < NSHM; i++) {
+            if (segs[i].used && !segs[i].removed && segs[i].key == key) {
+                int ok = segs[i].npages >= npages;
+                release(&shm_lock);
+                return ok ? i : SYSERR_INVALID_ARGS;
+            }
+        }
+    }
+
+    int id = -1;
+    for (int i = 0; i < NSHM; i++) {
+        if (!segs[i].used) {
+            id = i;
+            break;
+        }
+    }
+    if (id < 0) {
+        release(&shm_lock);
+        return SYSERR_RESOURCE_BUSY;
+    }
+    char *base = alloc_pages(npages);  // 已清零
+    if (base == NULL) {
+        release(&shm_lock);
+        return SYSERR_RESOURCE_BUSY;
+    }
+    segs[id].used = 1;
+    segs[id].key = key;
+    segs[id].npages = npages;
+    segs[id].base = base;
+    segs[id].refs = 0;
+    segs[id].removed = 0;
+    release(&shm_lock);
+    return id;
+}
+
+int shm_attach(int id, uint64_t *addr) {
+    struct proc *p = curr_proc;
+
+    if (p == NULL) {
+        return SYSERR_NOT_SUPPORTED;
+    }
+    if (id < 0 || id >= NSHM) {
+        return SYSERR_INVALID_ARGS;
+    }
+    acquire(&shm_lock);
+    if (!segs[id].used || segs[id].removed) {
+        release(&shm_lock);
+        return SYSERR_NOT_FOUND;
+    }
+    attached[p - proc][id]++;
+    segs[id].refs++;
+    *addr = (uint64_t)segs[id].base;
+    release(&shm_lock);
+    return 0;
+}
+
+// 解除一次挂接，段的最后一个挂接者解除时释放；调用者持有 shm_lock
+// 返回需要在锁外释放的页（没有则为 NULL）
+static char* shm_unref(int pslot, int id, int *npages) {
+    attached[pslot][id]--;
+    if (--segs[id].refs > 0) {
+        return NULL;
+    }
+    char *base = segs[id].base;
+    *npages = segs[id].npages;
+    segs[id].used = 0;
+    segs[id].base = NULL;
+    return base;
+}
+
+int shm_detach(uint64_t addr) {
+    struct proc *p = curr_proc;
+    char *base = NULL;
+    int npages = 0;
+
+    if (p == NULL) {
+        return SYSERR_NOT_SUPPORTED;
+    }
+    acquire(&shm_lock);
+    int id;
+    for (id = 0; id < NSHM; id++) {
+        if (segs[id].used && (uint64_t)segs[id].base == addr && attached[p - proc][id] > 0) {
+            break;
+        }
+    }
+    if (id == NSHM) {
+        release(&shm_lock);
+        return SYSERR_INVALID_ARGS;
+    }
+    base = shm_unref(p - proc, id, &npages);
+    release(&shm_lock);
+
+    if (base) {
+        free_pages(base, npages);
+    }
+    return 0;
+}
+
+// 创建后从未挂接的段不会经过 shm_unref，只能由这里释放
+int shm_remove(int id) {
+    char *base = NULL;
+    int npages = 0;
+
+    if (id < 0 || id >= NSHM) {
+        return SYSERR_INVALID_ARGS;
+    }
+    acquire(&shm_lock);
+    if (!segs[id].used || segs[id].removed) {
+        release(&shm_lock);
+        return SYSERR_NOT_FOUND;
+    }
+    segs[id].removed = 1;
+    if (segs[id].refs == 0) {
+        base = segs[id].base;
+        npages = segs[id].npages;
+        segs[id].used = 0;
+        segs[id].base = NULL;
+    }
+    release(&shm_lock);
+
+    if (base) {
+        free_pages(base, npages);
+    }
+    return 0;
+}
+
+void shm_release(struct proc *p) {
+    int pslot = p - proc;
+
+    for (int id = 0; id < NSHM; id++) {
+        char *base = NULL;
+        int npages = 0;
+
+        acquire(&shm_lock);
+        while (attached[pslot][id] > 0 && base == NULL) {
+            base = shm_unref(pslot, id, &npages);
+        }
+        attached[pslot][id] = 0;
+        release(&shm_lock);
+
+        if (base) {
+            free_pages(base, npages);
+        }
+    }
+}
+
+// 检查 futex 字：4 字节对齐，且落在当前进程挂接的某个段内
+// 返回字的物理地址，作为睡眠通道；地址非法返回 0
+static uint64_t futex_key(uint64_t addr) {
+    struct proc *p = curr_proc;
+    uint64_t pa = 0;
+
+    if (p == NULL || (addr & 3) != 0) {
+        return 0;
+    }
+    acquire(&shm_lock);
+    for (int id = 0; id < NSHM; id++) {
+        uint64_t base = (uint64_t)segs[id].base;
+        if (segs[id].used && attached[p - proc][id] > 0 &&
+            addr >= base && addr < base + (uint64_t)segs[id].npages * PAGE_SIZE) {
+            pa = walkaddr(p->pagetable, addr);
+            break;
+        }
+    }
+    release(&shm_lock);
+    return pa;
+}
+
+// 只在 *addr 仍等于 val 时睡眠；值已变化说明持有者已释放，立即返回
+int futex_wait(uint64_t addr, int val) {
+    uint64_t pa = futex_key(addr);
+    if (pa == 0) {
+        return SYSERR_MEMORY_FAULT;
+    }
+
+    // 比较与挂入等待队列之间关中断，避免与 futex_wake 之间丢失唤醒
+    push_off();
+    if (*(volatile int*)pa != val) {
+        pop_off();
+        return SYSERR_RESOURCE_BUSY;
+    }
+    if (curr_proc->killed) {
+        pop_off();
+        return SYSERR_RESOURCE_BUSY;
+    }
+    sleep((void*)pa);
+    pop_off();
+    return curr_proc->killed ? SYSERR_RESOURCE_BUSY : 0;
+}
+
+int futex_wake(uint64_t addr, int n) {
+    if (n <= 0) {
+        return SYSERR_INVALID_ARGS;
+    }
+    uint64_t pa = futex_key(addr);
+    if (pa == 0) {
+        return SYSERR_MEMORY_FAULT;
+    }
+    return wakeup_n((void*)pa, n);
+}
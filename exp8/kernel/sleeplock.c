@@ -0,0 +1,38 @@
+// kernel/sleeplock.c - 基于 sleep/wakeup 的睡眠锁
+#include "sleeplock.h"
+#include "proc.h"
+
+static inline int current_pid(void) {
+    return curr_proc ? curr_proc->pid : 0;
+}
+
+void initsleeplock(struct sleeplock *lk, const char *name) {
+    lk->locked = 0;
+    lk->name = name;
+    lk->pid = 0;
+}
+
+void acquiresleep(struct sleeplock *lk) {
+    push_off();
+    while (lk->locked) {
+        // sleep 在让出 CPU 前已挂入等待队列，release 的唤醒不会丢失；
+        // 调度器切换回来时恢复关中断状态
+        sleep(lk);
+    }
+    lk->locked = 1;
+    lk->pid = current_pid();
+    pop_off();
+}
+
+void releasesleep(struct sleeplock *lk) {
+    push_off();
+    lk->locked = 0;
+    lk->pid = 0;
+    // 只需唤醒一个：它拿到锁后，下次释放再唤醒下一个
+    wakeup_one(lk);
+    pop_off();
+}
+
+int holdingsleep(struct sleeplock *lk) {
+    return lk->locked && lk->pid == current_pid();
+}
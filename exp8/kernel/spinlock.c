@@ -0,0 +1,122 @@
+// kernel/spinlock.c - 票号自旋锁与锁竞争统计
+#include "spinlock.h"
+#include "printf.h"
+#include "proc.h"
+#include "trap.h"
+
+#if LOCK_STATS
+static struct spinlock *lock_list = NULL;  // 所有调用过 initlock 的锁
+
+static inline uint64_t read_cycle(void) {
+    uint64_t x;
+    asm volatile("csrr %0, mcycle" : "=r"(x));
+    return x;
+}
+#endif
+
+void initlock(struct spinlock *lk, const char *name) {
+    lk->next = 0;
+    lk->owner = 0;
+    lk->name = name;
+#if LOCK_STATS
+    lk->acquires = 0;
+    lk->contended = 0;
+    lk->spin_cycles = 0;
+    // 重复初始化（如重新挂载日志）不重复注册
+    if (!lk->registered) {
+        lk->registered = 1;
+        lk->stat_next = lock_list;
+        lock_list = lk;
+    }
+#endif
+}
+
+// 关中断并记录嵌套深度；最外层记下原来的 MIE，由对应的 pop_off 恢复
+void push_off(void) {
+    int old = intr_get();
+
+    intr_off();
+    struct cpu *c = mycpu();
+    if (c->noff == 0) {
+        c->intena = old;
+    }
+    c->noff++;
+}
+
+void pop_off(void) {
+    struct cpu *c = mycpu();
+
+    if (intr_get()) {
+        printf("pop_off: interrupts enabled\n");
+    }
+    if (c->noff < 1) {
+        printf("pop_off: unbalanced\n");
+        return;
+    }
+    c->noff--;
+    if (c->noff == 0 && c->intena) {
+        intr_on();
+    }
+}
+
+void acquire(struct spinlock *lk) {
+    push_off();  // 单核上持锁时被时钟中断抢占会死锁
+
+    uint32_t ticket = __atomic_fetch_add(&lk->next, 1, __ATOMIC_RELAXED);
+
+#if LOCK_STATS
+    if (__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket) {
+        uint64_t start = read_cycle();
+        while (__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket) {
+            // 自旋等待轮到自己
+        }
+        // 已持有锁，直接累加统计
+        lk->contended++;
+        lk->spin_cycles += read_cycle() - start;
+    }
+    lk->acquires++;
+#else
+    while (__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket) {
+        // 自旋等待轮到自己
+    }
+#endif
+}
+
+void release(struct spinlock *lk) {
+    // 只有持有者会修改 owner，普通读即可
+    __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+    pop_off();
+}
+
+// 复制已注册锁的统计，返回条目数
+int lockstat_collect(struct lockstat *out, int max) {
+    int n = 0;
+#if LOCK_STATS
+    for (struct spinlock *lk = lock_list; lk && n < max; lk = lk->stat_next) {
+        int i;
+        const char *name = lk->name ? lk->name : "?";
+        for (i = 0; i < (int)sizeof(out[n].name) - 1 && name[i]; i++) {
+            out[n].name[i] = name[i];
+        }
+        out[n].name[i] = '\0';
+        out[n].acquires = lk->acquires;
+        out[n].contended = lk->contended;
+        out[n].spin_cycles = lk->spin_cycles;
+        n++;
+    }
+#else
+    (void)out;
+    (void)max;
+#endif
+    return n;
+}
+
+void lockstat_reset(void) {
+#if LOCK_STATS
+    for (struct spinlock *lk = lock_list; lk; lk = lk->stat_next) {
+        lk->acquires = 0;
+        lk->contended = 0;
+        lk->spin_cycles = 0;
+    }
+#endif
+}
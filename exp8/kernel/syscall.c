@@ -9,28 +9,56 @@
 
 // 系统调用表定义（使用 include/syscall.h 中的声明/类型）
 struct syscall_desc syscall_table[SYSCALL_MAX] = {
-    [SYS_fork]    = {sys_fork,    "fork",    0, 0, 0},
-    [SYS_exit]    = {sys_exit,    "exit",    1, 0x1, 0}, // ARG_INT
-    [SYS_wait]    = {sys_wait,    "wait",    1, 0x2, 0}, // ARG_PTR  
-    [SYS_kill]    = {sys_kill,    "kill",    1, 0x1, 0},
-    [SYS_getpid]  = {sys_getpid,  "getpid",  0, 0, 0},
-    [SYS_write]   = {sys_write,   "write",   3, 0x1 | (0x2 << 4) | (0x1 << 8), 0},
-    [SYS_read]    = {sys_read,    "read",    3, 0x1 | (0x2 << 4) | (0x1 << 8), 0},
-    [SYS_open]    = {sys_open,    "open",    2, 0x2 | (0x1 << 4), 0},
-    [SYS_close]   = {sys_close,   "close",   1, 0x1, 0},
-    [SYS_unlink]  = {sys_unlink,  "unlink",  1, 0x2, 0},
-    [SYS_brk]     = {sys_brk,     "brk",     1, 0x2, 0},
-    [SYS_sbrk]    = {sys_sbrk,    "sbrk",    1, 0x1, 0},
-    [SYS_exec]    = {0,           "exec",    2, 0x2 | (0x2 << 4), 0},
-    [SYS_getppid] = {sys_getppid, "getppid", 0, 0, 0},
-    [SYS_getprocinfo] = {sys_getprocinfo, "getprocinfo", 1, 0x2, 0},  // 新增
-    [SYS_setpriority] = {sys_setpriority, "setpriority", 2, 0x1 | (0x1 << 4), 0},//设置进程优先级
-    [SYS_getpriority] = {sys_getpriority, "getpriority", 1, 0x1, 0},//获取进程优先级
+    [SYS_fork]    = {sys_fork,    "fork",    0, 0},
+    [SYS_exit]    = {sys_exit,    "exit",    1, 0x1}, // ARG_INT
+    [SYS_wait]    = {sys_wait,    "wait",    1, 0x2}, // ARG_PTR  
+    [SYS_kill]    = {sys_kill,    "kill",    1, 0x1},
+    [SYS_getpid]  = {sys_getpid,  "getpid",  0, 0},
+    [SYS_write]   = {sys_write,   "write",   3, 0x1 | (0x2 << 4) | (0x1 << 8)},
+    [SYS_read]    = {sys_read,    "read",    3, 0x1 | (0x2 << 4) | (0x1 << 8)},
+    [SYS_open]    = {sys_open,    "open",    2, 0x2 | (0x1 << 4)},
+    [SYS_close]   = {sys_close,   "close",   1, 0x1},
+    [SYS_unlink]  = {sys_unlink,  "unlink",  1, 0x2},
+    [SYS_brk]     = {sys_brk,     "brk",     1, 0x2},
+    [SYS_sbrk]    = {sys_sbrk,    "sbrk",    1, 0x1},
+    [SYS_exec]    = {0,           "exec",    2, 0x2 | (0x2 << 4)},
+    [SYS_sleep]   = {sys_sleep,   "sleep",   1, 0x1},
+    [SYS_getppid] = {sys_getppid, "getppid", 0, 0},
+    [SYS_getprocinfo] = {sys_getprocinfo, "getprocinfo", 1, 0x2},  // 新增
+    [SYS_setpriority] = {sys_setpriority, "setpriority", 2, 0x1 | (0x1 << 4)},//设置进程优先级
+    [SYS_getpriority] = {sys_getpriority, "getpriority", 1, 0x1},//获取进程优先级
+    [SYS_meminfo] = {sys_meminfo, "meminfo", 1, 0x2},//获取内存统计信息
+    [SYS_lockstat] = {sys_lockstat, "lockstat", 2, 0x2 | (0x1 << 4)},//获取锁竞争统计
+    [SYS_trace]   = {sys_trace,   "trace",   1, 0x2},//设置系统调用跟踪掩码
+    [SYS_syscallstats] = {sys_syscallstats, "syscallstats", 1, 0x1},//打印系统调用统计
+    [SYS_shmget]  = {sys_shmget,  "shmget",  2, 0x1 | (0x1 << 4)},//获取/创建共享内存段
+    [SYS_shmat]   = {sys_shmat,   "shmat",   2, 0x1 | (0x2 << 4)},//挂接共享内存段
+    [SYS_shmdt]   = {sys_shmdt,   "shmdt",   1, 0x2},//解除挂接
+    [SYS_futex_wait] = {sys_futex_wait, "futex_wait", 2, 0x2 | (0x1 << 4)},//futex 等待
+    [SYS_futex_wake] = {sys_futex_wake, "futex_wake", 2, 0x2 | (0x1 << 4)},//futex 唤醒
+    [SYS_shmrm]   = {sys_shmrm,   "shmrm",   1, 0x1},//删除共享内存段
 };
 
-// 使用 include/syscall.h 中定义的 syscall_result_t
+// 没有进程上下文（内核自测直接调用 sys_*）时的错误码
+static int noproc_error = SYSERR_SUCCESS;
 
-static int last_error = SYSERR_SUCCESS;
+// 系统调用跟踪掩码，为 0 时分发路径上不打印任何东西
+static uint64_t syscall_trace_mask = 0;
+
+// 每个 CPU 一份的系统调用统计，分发器只写本 CPU 的那份，不需要加锁
+static struct syscall_stat syscall_stats[NCPU][SYSCALL_MAX];
+
+static inline uint64_t read_time(void) {
+    uint64_t t;
+    asm volatile("csrr %0, time" : "=r"(t));
+    return t;
+}
+
+// 延迟所在的 log2 桶：0 表示不足 1 个 time 单位，桶 i 覆盖 [2^(i-1), 2^i)
+static inline int latency_bucket(uint64_t delta) {
+    int b = delta ? 64 - __builtin_clzl(delta) : 0;
+    return b < SYSCALL_HIST_BUCKETS ? b : SYSCALL_HIST_BUCKETS - 1;
+}
 
 // myproc is provided by sysproc.c (kernel/sysproc.c)
 
@@ -175,13 +203,19 @@ uint64_t walkaddr(pagetable_t pagetable, uint64_t va) {
     return va;
 }
 
-// 错误处理
+// 错误处理：错误码记在当前进程上，由分发器写入 a0；系统调用中途睡眠也不会被别的进程覆盖
 void set_syscall_error(int err) {
-    last_error = err;
+    struct proc *p = curr_proc;
+    if (p) {
+        p->syscall_err = err;
+    } else {
+        noproc_error = err;
+    }
 }
 
 int get_last_syscall_error(void) {
-    return last_error;
+    struct proc *p = curr_proc;
+    return p ? p->syscall_err : noproc_error;
 }
 
 const char *syscall_error_str(int err) {
@@ -198,89 +232,98 @@ const char *syscall_error_str(int err) {
     }
 }
 
-// 权限检查
-int check_syscall_permission(struct proc *p, int syscall_num) {
-    if (!p) {
-        return 0;
-    }
-    
-    // 简化实现：所有系统调用都允许
-    // 在实际系统中需要根据进程权限和系统调用类型进行检查
-    
-    // 检查系统调用号范围
-    if (syscall_num < 0 || syscall_num >= SYSCALL_MAX) {
-        return 0;
-    }
-    
-    // 检查系统调用是否实现
-    if (!syscall_table[syscall_num].func) {
-        return 0;
+void syscall_set_trace(uint64_t mask) {
+    syscall_trace_mask = mask;
+}
+
+// 跟踪输出放在分发路径之外，未开启跟踪时不占用快速路径
+static void syscall_trace(struct proc *p, uint64_t num, long ret) {
+    if (ret < 0 && ret >= SYSERR_INTERNAL) {
+        printf("[%d] %s -> %s\n", p->pid, syscall_table[num].name, syscall_error_str((int)ret));
+    } else {
+        printf("[%d] %s -> %ld\n", p->pid, syscall_table[num].name, ret);
     }
-    
-    return 1;
 }
 
-// 系统调用分发器
+// 系统调用分发器：一次边界检查后按下标调用，结果（或负的错误码）直接写回 a0
 void syscall_dispatch(struct trap_context *ctx) {
-    struct proc *p = myproc();
-    if (!p) {
-        // 如果没有当前进程，设置错误并返回
-        printf("SYSCALL: no current process\n");
-        ctx->a0 = -1;
+    struct proc *p = curr_proc;
+    uint64_t num = ctx->a7;
+    int (*fn)(void);
+    long ret;
+
+    this_cpu(nsyscall)++;
+    if (num >= SYSCALL_MAX || !(fn = syscall_table[num].func) || !p) {
+        ctx->a0 = SYSERR_NOT_SUPPORTED;
         return;
     }
-    
-    // 保存陷阱上下文到进程结构中
+
     p->trap_context = ctx;
-    
-    uint64_t syscall_num = ctx->a7;
-     printf("DEBUG: syscall_dispatch called, num=%lu, pid=%d\n", 
-           syscall_num, p->pid);
-           
-    syscall_result_t result = {0, SYSERR_SUCCESS};
-    
-    // 重置错误状态
-    set_syscall_error(SYSERR_SUCCESS);
-    
-    // 系统调用号验证
-    if (syscall_num >= SYSCALL_MAX || !syscall_table[syscall_num].func) {
-        printf("SYSCALL: unknown syscall %d from pid %d\n", 
-               (int)syscall_num, p->pid);
-        result.error = SYSERR_NOT_SUPPORTED;
-        ctx->a0 = -1;
-        return;
+    p->syscall_err = SYSERR_SUCCESS;
+    uint64_t start = read_time();
+    ret = fn();
+    uint64_t delta = read_time() - start;
+    if (p->syscall_err != SYSERR_SUCCESS) {
+        ret = p->syscall_err;
     }
-    
-    // 权限检查
-    if (!check_syscall_permission(p, syscall_num)) {
-        printf("SYSCALL: permission denied for %s from pid %d\n",
-               syscall_table[syscall_num].name, p->pid);
-        result.error = SYSERR_ACCESS_DENIED;
-        ctx->a0 = -1;
-        return;
+    ctx->a0 = ret;
+    p->trap_context = NULL;
+
+    // 系统调用中途可能睡眠后换到别的 CPU 上返回，记在返回时所在 CPU 的统计里
+    struct syscall_stat *st = &syscall_stats[cpuid()][num];
+    st->count++;
+    if (ret < 0 && ret >= SYSERR_INTERNAL) {
+        st->errors++;
     }
-    
-    printf("SYSCALL: %s called from pid %d\n", 
-           syscall_table[syscall_num].name, p->pid);
-    
-    // 执行系统调用
-    result.return_value = syscall_table[syscall_num].func();
-    result.error = get_last_syscall_error();
-    
-    // 设置返回值
-    if (result.error != SYSERR_SUCCESS) {
-        ctx->a0 = -1;
-        printf("SYSCALL: %s failed with error: %s\n",
-               syscall_table[syscall_num].name, 
-               syscall_error_str(result.error));
-    } else {
-        ctx->a0 = result.return_value;
-     printf("SYSCALL: %s returning %ld\n",
-         syscall_table[syscall_num].name, result.return_value);
+    st->hist[latency_bucket(delta)]++;
+
+    if (syscall_trace_mask & (1UL << num)) {
+        syscall_trace(p, num, ret);
     }
-    
-    // 清除陷阱上下文引用
-    p->trap_context = NULL;
+}
+
+// 汇总各 CPU 的统计；num 越界返回 -1
+int syscall_stat_get(int num, struct syscall_stat *out) {
+    if (num < 0 || num >= SYSCALL_MAX) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    for (int c = 0; c < NCPU; c++) {
+        struct syscall_stat *st = &syscall_stats[c][num];
+        out->count += st->count;
+        out->errors += st->errors;
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            out->hist[b] += st->hist[b];
+        }
+    }
+    return 0;
+}
+
+void syscall_stats_reset(void) {
+    memset(syscall_stats, 0, sizeof(syscall_stats));
+}
+
+// 打印调用过的系统调用：次数、错误数与延迟直方图（只列出非空的桶，单位为 time CSR 计数）
+void syscall_stats_dump(void) {
+    struct syscall_stat st;
+
+    printf("=== Syscall Statistics ===\n");
+    printf("%12s %10s %8s  latency histogram [<2^i ticks]:count\n", "name", "count", "errors");
+    for (int i = 0; i < SYSCALL_MAX; i++) {
+        syscall_stat_get(i, &st);
+        if (st.count == 0) {
+            continue;
+        }
+        printf("%12s %10lu %8lu ", syscall_table[i].name ? syscall_table[i].name : "?",
+               st.count, st.errors);
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            if (st.hist[b]) {
+                printf(" %d:%lu", b, st.hist[b]);
+            }
+        }
+        printf("\n");
+    }
+    printf("==========================\n");
 }
 
 // 系统调用初始化
@@ -338,12 +381,25 @@ void test_syscall_framework(void) {
         printf("✗ Error handling test FAILED\n");
     }
     
-    // 测试权限检查
-    printf("Testing permission checks...\n");
-    if (check_syscall_permission(myproc(), SYS_getpid)) {
-        printf("✓ Permission check test PASSED\n");
+    // 测试分发器：未知系统调用号在 a0 中返回错误码
+    printf("Testing dispatch error return...\n");
+    struct trap_context ctx = {0};
+    ctx.a7 = SYSCALL_MAX;
+    syscall_dispatch(&ctx);
+    if ((int64_t)ctx.a0 == SYSERR_NOT_SUPPORTED) {
+        printf("✓ Dispatch error test PASSED\n");
     } else {
-        printf("✗ Permission check test FAILED\n");
+        printf("✗ Dispatch error test FAILED\n");
+    }
+
+    if (myproc()) {
+        ctx.a7 = SYS_getpid;
+        syscall_dispatch(&ctx);
+        if ((int)ctx.a0 == myproc()->pid) {
+            printf("✓ Dispatch getpid test PASSED\n");
+        } else {
+            printf("✗ Dispatch getpid test FAILED\n");
+        }
     }
     
     printf("System call framework test completed\n");
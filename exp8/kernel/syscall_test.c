@@ -6,6 +6,9 @@
 #include "clock.h"
 #include "console.h"
 #include "syscall.h"
+#include "mm.h"
+#include "shm.h"
+#include "trap.h"
 
 
 void test_basic_syscalls(void) {
@@ -224,6 +227,331 @@ void test_getprocinfo(void) {
     printf("✓ Simplified getprocinfo test completed\n\n");
 }
 
+// 经 syscall_dispatch 发起系统调用，走与 ecall 相同的参数检查与分发
+static int64_t kernel_syscall(int num, uint64_t a0, uint64_t a1) {
+    struct trap_context ctx = {0};
+    ctx.a0 = a0;
+    ctx.a1 = a1;
+    ctx.a7 = num;
+    syscall_dispatch(&ctx);
+    return (int64_t)ctx.a0;
+}
+
+void test_meminfo(void) {
+    printf("=== Testing Memory Statistics ===\n");
+
+    struct meminfo before, after;
+    if (kernel_syscall(SYS_meminfo, (uint64_t)&before, 0) != 0) {
+        printf("✗ meminfo syscall failed\n\n");
+        return;
+    }
+    if (kernel_syscall(SYS_meminfo, 0, 0) < 0) {
+        printf("✓ meminfo(NULL) rejected\n");
+    } else {
+        printf("✗ meminfo(NULL) accepted\n");
+    }
+
+    uint64_t block_pages = 0;
+    for (int i = 0; i <= BUDDY_MAX_ORDER; i++) {
+        block_pages += before.free_blocks[i] << i;
+    }
+    printf("total=%lu free=%lu cached=%lu pagetable=%lu failures=%lu/%lu\n",
+           before.total_pages, before.free_pages, before.cached_pages,
+           before.pagetable_pages,
+           before.alloc_page_failures, before.alloc_pages_failures);
+
+    if (block_pages + before.cached_pages == before.free_pages &&
+        before.free_pages <= before.total_pages) {
+        printf("✓ Per-order free blocks consistent with free page count\n");
+    } else {
+        printf("✗ Free page accounting mismatch\n");
+    }
+
+    void *p = alloc_pages(4);
+    int64_t ret = kernel_syscall(SYS_meminfo, (uint64_t)&after, 0);
+    if (p && ret == 0 && after.free_pages + 4 == before.free_pages) {
+        printf("✓ alloc_pages(4) reflected in meminfo\n");
+    } else {
+        printf("✗ alloc_pages(4) not reflected: %lu -> %lu\n",
+               before.free_pages, after.free_pages);
+    }
+    free_pages(p, 4);
+
+    printf("Memory statistics test completed\n\n");
+}
+
+static volatile int oneshot_hits;
+static volatile int periodic_hits;
+
+static void count_hit(void *arg) {
+    (*(volatile int *)arg)++;
+}
+
+void test_timer_wheel(void) {
+    printf("=== Testing Timer Wheel ===\n");
+
+    struct timer oneshot, periodic;
+    oneshot_hits = 0;
+    periodic_hits = 0;
+    timer_setup(&oneshot, count_hit, (void *)&oneshot_hits);
+    timer_setup(&periodic, count_hit, (void *)&periodic_hits);
+    timer_add(&oneshot, 1, 0);
+    timer_add(&periodic, 1, 1);
+
+    // 时间轮由时钟中断推进，这里只等待：最多 20 个 tick
+    uint64_t start, now;
+    READ_TIME(start);
+    do {
+        READ_TIME(now);
+    } while (periodic_hits < 3 && now - start < 20 * TICK_CYCLES);
+
+    // 两个定时器都在栈上，先无条件摘下再检查结果，返回后时间轮不能再引用它们
+    int oneshot_pending = timer_del(&oneshot);
+    int periodic_pending = timer_del(&periodic);
+
+    if (!intr_get()) {
+        printf("✗ Interrupts are off, the timer wheel cannot advance\n");
+    }
+    if (oneshot_hits == 1 && oneshot_pending == 0) {
+        printf("✓ One-shot timer fired exactly once\n");
+    } else {
+        printf("✗ One-shot timer fired %d times\n", oneshot_hits);
+    }
+    if (periodic_hits >= 3 && periodic_pending == 1) {
+        printf("✓ Periodic timer re-armed (%d hits)\n", periodic_hits);
+    } else {
+        printf("✗ Periodic timer fired %d times\n", periodic_hits);
+    }
+
+    printf("Timer wheel test completed\n\n");
+}
+
+void test_syscall_stats(void) {
+    printf("=== Testing Syscall Statistics ===\n");
+
+    if (!myproc()) {
+        printf("Skipped: no current process\n\n");
+        return;
+    }
+
+    struct syscall_stat before, after;
+    struct trap_context ctx = {0};
+    int iterations = 100;
+
+    syscall_stat_get(SYS_getpid, &before);
+    for (int i = 0; i < iterations; i++) {
+        ctx.a7 = SYS_getpid;
+        syscall_dispatch(&ctx);
+    }
+    syscall_stat_get(SYS_getpid, &after);
+
+    uint64_t bucketed = 0;
+    for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+        bucketed += after.hist[b] - before.hist[b];
+    }
+    if (after.count - before.count == (uint64_t)iterations && bucketed == (uint64_t)iterations &&
+        after.errors == before.errors) {
+        printf("✓ getpid counted %d times, all in the latency histogram\n", iterations);
+    } else {
+        printf("✗ getpid count %lu, histogram %lu, errors %lu\n",
+               after.count - before.count, bucketed, after.errors - before.errors);
+    }
+
+    // kill 不存在的进程应记为一次错误，错误码在 a0 中返回
+    syscall_stat_get(SYS_kill, &before);
+    ctx.a0 = -1;
+    ctx.a7 = SYS_kill;
+    syscall_dispatch(&ctx);
+    syscall_stat_get(SYS_kill, &after);
+    if (after.errors - before.errors == 1 && (int64_t)ctx.a0 == SYSERR_NOT_FOUND) {
+        printf("✓ Failed kill counted as an error\n");
+    } else {
+        printf("✗ Failed kill not counted as an error\n");
+    }
+
+    syscall_stats_dump();
+    printf("Syscall statistics test completed\n\n");
+}
+
+// 共享内存 + futex：等待者在共享字上 futex_wait，唤醒者写值后 futex_wake
+static int shm_test_id;
+static volatile int shm_waiter_saw;    // 等待者醒来后读到的数据
+static volatile int shm_waker_woken;   // futex_wake 的返回值
+static volatile int shm_waker_errors;  // 唤醒者检查的错误路径中不符合预期的个数
+static volatile int shm_done;
+
+// word[0] 为 futex 字，word[1] 为数据，word[2] 为等待者就绪标志
+static void shm_waiter(void) {
+    uint64_t addr = 0;
+
+    if (kernel_syscall(SYS_shmat, shm_test_id, (uint64_t)&addr) == 0) {
+        volatile int *word = (volatile int*)addr;
+        word[2] = 1;
+        while (word[0] == 0) {
+            kernel_syscall(SYS_futex_wait, (uint64_t)word, 0);
+        }
+        shm_waiter_saw = word[1];
+        kernel_syscall(SYS_shmdt, addr, 0);
+    }
+    shm_done++;
+    exit_process(0);
+}
+
+static void shm_waker(void) {
+    uint64_t addr = 0;
+    int local = 0;
+
+    if (kernel_syscall(SYS_shmat, shm_test_id, (uint64_t)&addr) == 0) {
+        volatile int *word = (volatile int*)addr;
+        for (int i = 0; i < 100 && !word[2]; i++) {
+            yield();
+        }
+        yield();    // 等待者置就绪标志后紧接着 futex_wait，再让一次确保它已睡下
+        word[1] = 42;
+        word[0] = 1;
+        shm_waker_woken = kernel_syscall(SYS_futex_wake, (uint64_t)word, 1);
+
+        // 值已变化时 futex_wait 立即返回；不在共享段内的地址被拒绝
+        if (kernel_syscall(SYS_futex_wait, (uint64_t)word, 0) != SYSERR_RESOURCE_BUSY) {
+            shm_waker_errors++;
+        }
+        if (kernel_syscall(SYS_futex_wake, (uint64_t)&local, 1) != SYSERR_MEMORY_FAULT) {
+            shm_waker_errors++;
+        }
+        kernel_syscall(SYS_shmdt, addr, 0);
+        if (kernel_syscall(SYS_shmdt, addr, 0) != SYSERR_INVALID_ARGS) {
+            shm_waker_errors++;
+        }
+    }
+    shm_done++;
+    exit_process(0);
+}
+
+void test_shm_futex(void) {
+    printf("=== Testing Shared Memory and Futex ===\n");
+
+    shm_test_id = shm_get(SHM_PRIVATE, PAGE_SIZE);
+    if (shm_test_id < 0) {
+        printf("✗ shm_get failed: %d\n\n", shm_test_id);
+        return;
+    }
+    shm_waiter_saw = 0;
+    shm_waker_woken = -1;
+    shm_waker_errors = 0;
+    shm_done = 0;
+
+    int waiter = create_process(shm_waiter);
+    int waker = create_process(shm_waker);
+    if (waiter < 0 || waker < 0) {
+        printf("✗ Failed to create test processes\n\n");
+        return;
+    }
+
+    // 在进程中运行时靠 wait_process 让出 CPU；否则直接驱动调度器
+    int status;
+    if (!myproc()) {
+        for (int guard = 0; shm_done < 2 && guard < 1024; guard++) {
+            scheduler();
+        }
+    }
+    wait_process(&status);
+    wait_process(&status);
+
+    int failures = 0;
+    if (shm_done == 2 && shm_waiter_saw == 42) {
+        printf("✓ Waiter saw data written through the shared segment\n");
+    } else {
+        printf("✗ Waiter saw %d (done=%d)\n", shm_waiter_saw, shm_done);
+        failures++;
+    }
+    if (shm_waker_woken == 1) {
+        printf("✓ futex_wake woke the sleeping waiter\n");
+    } else {
+        printf("✗ futex_wake returned %d, expected to wake the waiter\n", shm_waker_woken);
+        failures++;
+    }
+    if (shm_waker_errors == 0) {
+        printf("✓ Stale value, foreign address and double detach rejected\n");
+    } else {
+        printf("✗ %d error paths not rejected\n", shm_waker_errors);
+        failures++;
+    }
+
+    // 从未挂接过的段只能靠 shmrm 释放；删除后不能再挂接
+    uint64_t addr = 0;
+    int id = kernel_syscall(SYS_shmget, SHM_PRIVATE, PAGE_SIZE);
+    if (id >= 0 && kernel_syscall(SYS_shmrm, id, 0) == 0 &&
+        kernel_syscall(SYS_shmat, id, (uint64_t)&addr) == SYSERR_NOT_FOUND &&
+        kernel_syscall(SYS_shmrm, id, 0) == SYSERR_NOT_FOUND) {
+        printf("✓ Unattached segment freed by shmrm\n");
+    } else {
+        printf("✗ shmrm of unattached segment %d failed\n", id);
+        failures++;
+    }
+
+    if (failures) {
+        printf("✗ %d shared memory checks failed\n", failures);
+    }
+
+    printf("Shared memory test completed\n\n");
+}
+
+// 陷阱路径：ecall 走完整帧，返回值经 trap_context.a0 写回；
+// 中断快速路径借用 mscratch 保存陷阱栈顶，陷阱返回后必须原样还原
+void test_trap_paths(void) {
+    extern void trap_vector(void);
+    uint64_t mtvec, scratch_before, scratch_after, sp_before, sp_after;
+    int64_t ret;
+
+    printf("=== Testing Trap Entry Paths ===\n");
+
+    asm volatile("csrr %0, mtvec" : "=r"(mtvec));
+    if (mtvec != ((uint64_t)trap_vector | 1) || curr_proc == NULL) {
+        printf("Trap vector not installed or no current process, skipped\n\n");
+        return;
+    }
+    printf("✓ mtvec in vectored mode at %p\n", (void*)trap_vector);
+
+    asm volatile("csrr %0, mscratch" : "=r"(scratch_before));
+    asm volatile("mv %0, sp" : "=r"(sp_before));
+    {
+        register uint64_t a0 asm("a0") = 0;
+        register uint64_t a7 asm("a7") = SYS_getpid;
+        asm volatile("ecall" : "+r"(a0) : "r"(a7) : "memory");
+        ret = (int64_t)a0;
+    }
+    asm volatile("mv %0, sp" : "=r"(sp_after));
+    asm volatile("csrr %0, mscratch" : "=r"(scratch_after));
+
+    if (ret == curr_proc->pid) {
+        printf("✓ ecall returned pid %d through the trap frame\n", (int)ret);
+    } else {
+        printf("✗ ecall returned %ld, expected pid %d\n", (long)ret, curr_proc->pid);
+    }
+    if (sp_after == sp_before) {
+        printf("✓ sp restored after exception return\n");
+    } else {
+        printf("✗ sp changed: %p -> %p\n", (void*)sp_before, (void*)sp_after);
+    }
+
+    // 最多等 1 秒，让中断走过快速路径
+    uint64_t nintr = this_cpu(nintr);
+    uint64_t start, now;
+    READ_TIME(start);
+    do {
+        READ_TIME(now);
+    } while (this_cpu(nintr) == nintr && now - start < CLOCK_FREQ);
+    asm volatile("csrr %0, mscratch" : "=r"(scratch_after));
+    if (scratch_after == scratch_before) {
+        printf("✓ mscratch still holds the trap stack top (%lu interrupts seen)\n",
+               (unsigned long)(this_cpu(nintr) - nintr));
+    } else {
+        printf("✗ mscratch changed: %p -> %p\n", (void*)scratch_before, (void*)scratch_after);
+    }
+
+    printf("Trap path test completed\n\n");
+}
+
 // 综合测试函数
 void run_comprehensive_syscall_tests(void) {
     printf("\n🔧 STARTING COMPREHENSIVE SYSTEM CALL TESTS\n");
@@ -242,6 +570,21 @@ void run_comprehensive_syscall_tests(void) {
 
     // 新增：进程信息测试
     // test_getprocinfo();
+
+    //内存统计测试
+    test_meminfo();
+
+    //定时器测试
+    test_timer_wheel();
+
+    //系统调用统计
+    test_syscall_stats();
+
+    //共享内存与 futex
+    test_shm_futex();
+
+    //陷阱入口路径
+    test_trap_paths();
     
     printf("\n✅ ALL SYSTEM CALL TESTS COMPLETED\n");
 }
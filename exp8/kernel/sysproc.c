@@ -8,6 +8,10 @@
 #include "fs.h"
 #include "file.h"
 #include "log.h"
+#include "bio.h"
+#include "clock.h"
+#include "uart.h"
+#include "shm.h"
 
 #define SYSERR_SUCCESS 0
 #define SYSERR_INVALID_ARGS -1
@@ -70,11 +74,13 @@ int sys_fork(void) {
         void *stack = alloc_page();
         if (stack) {
             p->kstack = (uint64_t)stack;
+            p->kstack_pages = 1;
             p->context.sp = p->kstack + PAGE_SIZE;
         }
     }
     
     p->state = RUNNABLE;
+    sched_kick();
     
     printf("SYSCALL: fork created process %d, ra=%p, sp=%p\n", 
            p->pid, (void*)p->context.ra, (void*)p->context.sp);
@@ -144,14 +150,14 @@ int sys_kill(void) {
     
     // 查找目标进程
     struct proc *target = NULL;
-    spin_lock(&proc_lock);
+    acquire(&proc_lock);
     for (int i = 0; i < NPROC; i++) {
         if (proc[i].state != UNUSED && proc[i].pid == pid) {
             target = &proc[i];
             break;
         }
     }
-    spin_unlock(&proc_lock);
+    release(&proc_lock);
     
     if (!target) {
         set_syscall_error(SYSERR_NOT_FOUND);
@@ -164,6 +170,7 @@ int sys_kill(void) {
     // 如果进程在睡眠，唤醒它
     if (target->state == SLEEPING) {
         target->state = RUNNABLE;
+        sched_kick();
     }
     
     return 0;
@@ -283,7 +290,7 @@ int sys_read(void) {
         n = 4096; // 限制为4KB
     }
     
-    // 简化实现：返回模拟数据
+    // 从 UART 接收环读取，没有输入时睡眠
     struct proc *p = myproc();
     char *kbuf = alloc_page();
     if(!kbuf) {
@@ -291,12 +298,12 @@ int sys_read(void) {
         return -1;
     }
     
-    // 模拟读取数据
-    const char *test_data = "test input from stdin\n";
-    int data_len = strlen(test_data);
-    int read_len = n < data_len ? n : data_len;
-    // copy without relying on libc memcpy
-    for (int i = 0; i < read_len; i++) kbuf[i] = test_data[i];
+    int read_len = uart_read(kbuf, n);
+    if(read_len < 0) {
+        free_page(kbuf);
+        set_syscall_error(SYSERR_RESOURCE_BUSY);
+        return -1;
+    }
     
     // 拷贝到用户空间
     if(copyout(p->pagetable, buf_addr, kbuf, read_len) < 0) {
@@ -386,6 +393,11 @@ int sys_getprocinfo(void) {
     info.pid = p->pid;
     info.state = p->state;
     info.parent_pid = p->parent ? p->parent->pid : 0;
+    info.sz = p->sz;
+    info.user_pages = p->user_pages;
+    info.pt_pages = p->pt_pages;
+    info.kstack_pages = p->kstack_pages;
+    info.bcache_bufs = p->bcache_bufs;
     
     // 复制进程名称（确保以null结尾）
     int i;
@@ -408,6 +420,91 @@ int sys_getprocinfo(void) {
     return 0;
 }
 
+// 获取内存统计信息：只读计数器，不遍历页，适合高频轮询
+int sys_meminfo(void) {
+    uint64_t info_ptr;
+
+    if (argaddr(0, &info_ptr) < 0 || info_ptr == 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+
+    struct meminfo info;
+    pmm_get_meminfo(&info);
+    info.bcache_bufs = bcache_nbuf();
+    info.bcache_bytes = info.bcache_bufs * sizeof(struct buf);
+
+    // 与 getprocinfo 一致，内核测试环境下直接拷贝
+    struct meminfo *dest = (struct meminfo*)info_ptr;
+    *dest = info;
+    return 0;
+}
+
+// 获取锁竞争统计：lockstat(struct lockstat *buf, int n)，返回条目数
+// n 为 0 时清零所有计数
+int sys_lockstat(void) {
+    uint64_t buf_ptr;
+    int n;
+
+    if (argaddr(0, &buf_ptr) < 0 || argint(1, &n) < 0 || n < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    if (n == 0) {
+        lockstat_reset();
+        return 0;
+    }
+    if (buf_ptr == 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+
+    // 与 getprocinfo 一致，内核测试环境下直接拷贝
+    return lockstat_collect((struct lockstat*)buf_ptr, n);
+}
+
+// 设置系统调用跟踪掩码：trace(mask)，第 n 位置 1 时打印 n 号系统调用的返回值
+int sys_trace(void) {
+    uint64_t mask;
+
+    if (argaddr(0, &mask) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    syscall_set_trace(mask);
+    return 0;
+}
+
+// 打印系统调用统计：syscallstats(int reset)，reset 非 0 时打印后清零
+int sys_syscallstats(void) {
+    int reset;
+
+    if (argint(0, &reset) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    syscall_stats_dump();
+    if (reset) {
+        syscall_stats_reset();
+    }
+    return 0;
+}
+
+// 睡眠 n 个时钟 tick（TICK_CYCLES），由自己的定时器唤醒
+int sys_sleep(void) {
+    int n;
+    if (argint(0, &n) < 0 || n < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    clock_sleep((uint64_t)n);
+    if (myproc()->killed) {
+        set_syscall_error(SYSERR_RESOURCE_BUSY);
+        return -1;
+    }
+    return 0;
+}
+
 // 设置进程优先级
 int sys_setpriority(void) {
     int pid, value;
@@ -598,4 +695,86 @@ int sys_unlink(void) {
     
     printf("SYSCALL: unlink - path='%s'\n", path);
     return 0;
-}
\ No newline at end of file
+}
+// 共享内存与 futex：内核函数返回负的 SYSERR_* 错误码，这里转成 set_syscall_error
+static int shm_result(int r) {
+    if (r < 0) {
+        set_syscall_error(r);
+        return -1;
+    }
+    return r;
+}
+
+// shmget(key, size)：返回段号，key 为 0 时总是新建
+int sys_shmget(void) {
+    int key, size;
+
+    if (argint(0, &key) < 0 || argint(1, &size) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    return shm_result(shm_get(key, size));
+}
+
+// shmat(id, uint64_t *addr)：段地址写入 *addr
+// 调用者都是内核线程，addr 在 0x80000000 以上的内核栈上，copyout 会拒绝；
+// 与 getprocinfo/meminfo 一致直接写入
+int sys_shmat(void) {
+    int id;
+    uint64_t addr_ptr, addr;
+
+    if (argint(0, &id) < 0 || argaddr(1, &addr_ptr) < 0 || addr_ptr == 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    if (shm_result(shm_attach(id, &addr)) < 0) {
+        return -1;
+    }
+    *(uint64_t*)addr_ptr = addr;
+    return 0;
+}
+
+int sys_shmdt(void) {
+    uint64_t addr;
+
+    if (argaddr(0, &addr) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    return shm_result(shm_detach(addr));
+}
+
+// futex_wait(addr, val)：值已不等于 val 时返回 SYSERR_RESOURCE_BUSY，调用者应重试
+int sys_futex_wait(void) {
+    uint64_t addr;
+    int val;
+
+    if (argaddr(0, &addr) < 0 || argint(1, &val) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    return shm_result(futex_wait(addr, val));
+}
+
+// futex_wake(addr, n)：返回实际唤醒的进程数
+int sys_futex_wake(void) {
+    uint64_t addr;
+    int n;
+
+    if (argaddr(0, &addr) < 0 || argint(1, &n) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    return shm_result(futex_wake(addr, n));
+}
+
+// shmrm(id)：段不再能被找到或挂接；没有挂接者时立即释放
+int sys_shmrm(void) {
+    int id;
+
+    if (argint(0, &id) < 0) {
+        set_syscall_error(SYSERR_INVALID_ARGS);
+        return -1;
+    }
+    return shm_result(shm_remove(id));
+}
@@ -3,6 +3,7 @@
 #include "printf.h"
 #include "clock.h"
 #include "uart.h"
+#include "plic.h"
 #include "exception.h"
 #include "proc.h"
 #include "syscall.h"
@@ -27,71 +28,90 @@ static const char* trap_cause_names[] = {
     "store/AMO page fault"
 };
 
-// kernel/trap.c - 修复 printf 格式
-void trap_handler(struct trap_context *ctx) {
-    // 读取陷阱原因
+// 每个 hart 的中断陷阱栈，栈顶放在 mscratch，trap_entry.S 的中断入口切换到这里
+#define TRAP_STACK_SIZE 4096
+static char trap_stack[NCPU][TRAP_STACK_SIZE] __attribute__((aligned(16)));
+
+// 中断处理函数由 trap_entry.S 的向量表直接调用，运行在陷阱栈上，
+// 不能睡眠或切换进程；返回非 0 时入口代码回到被打断的栈上 yield
+
+int trap_timer_interrupt(void) {
+    this_cpu(nintr)++;
+    clock_set_next_event();
+
+    // 只有调度 tick 到期才抢占，其他定时器（睡眠唤醒等）的中断不切换进程；
+    // 睡眠者在 scheduler() 里等中断时不抢占它
+    return curr_proc != 0 && curr_proc->state == RUNNING && clock_need_resched();
+}
+
+int trap_external_interrupt(void) {
+    this_cpu(nintr)++;
+
+    // 外部中断，经 PLIC 路由
+    int irq = plic_claim();
+    if (irq == UART0_IRQ) {
+        uart_interrupt_handler();
+    } else if (irq) {
+        printf("Unexpected external irq: %d\n", irq);
+    }
+    if (irq) {
+        plic_complete(irq);
+    }
+    return 0;
+}
+
+int trap_unknown_interrupt(void) {
     uint64_t cause;
     asm volatile("csrr %0, mcause" : "=r" (cause));
-    
-    // 读取 mtval
-    asm volatile("csrr %0, mtval" : "=r" (ctx->mtval));
-    
-    // 判断是中断还是异常
-    if (cause & 0x8000000000000000) {
-        // 中断处理
-        int int_code = cause & 0x7FFFFFFFFFFFFFFF;
-        
-        switch (int_code) {
-            case 7: // 定时器中断
-                clock_set_next_event();
-
-                // 触发调度
-                if (curr_proc!=0) {
-                    yield();
-                }
-                break;
-            default:
-                // 仅对未知中断保留一次性提示
-                printf("Unknown interrupt: %d\n", int_code);
-                break;
-        }
+    this_cpu(nintr)++;
+
+    // 仅对未知中断保留一次性提示
+    printf("Unknown interrupt: %d\n", (int)(cause & 0x7FFFFFFFFFFFFFFF));
+    return 0;
+}
+
+// 异常与系统调用；mcause 和 mtval 已由 trap_entry.S 读好
+void trap_handler(struct trap_context *ctx, uint64_t cause) {
+    int exc_code = cause & 0xF;
+
+    if (exc_code == CAUSE_USER_ECALL || exc_code == CAUSE_SUPERVISOR_ECALL ||
+        exc_code == CAUSE_MACHINE_ECALL) {
+        // 环境调用（系统调用）：进程都跑在 M 模式，ecall 的原因号是 11；返回到 ecall 的下一条指令
+        ctx->mepc += 4;
+        syscall_dispatch(ctx);
     } else {
-        // 异常处理
-        // 修复：使用正确的格式说明符（仅异常时打印详细信息）
         printf("TRAP: cause=0x%lx, mepc=0x%lx, mtval=0x%lx\n",
             cause, (unsigned long)ctx->mepc, (unsigned long)ctx->mtval);
-        int exc_code = cause & 0xF;
-        
-            if (exc_code == 8 || exc_code == 9) {
-                // 环境调用（系统调用）
-                syscall_dispatch(ctx);
-        } else
-        {
         // 显示异常信息
-        printf("EXCEPTION: %d - %s\n", exc_code, 
+        printf("EXCEPTION: %d - %s\n", exc_code,
                exc_code < 16 ? trap_cause_names[exc_code] : "unknown");
-        
+
         // 调用异常处理模块
         handle_exception(ctx, cause);
-        
+
         printf("Exception handled, new mepc=%p\n", (void*)ctx->mepc);
-        }
     }
 }
 
 // 陷阱初始化
 void trap_init(void) {
     extern void trap_vector(void);
-    uint64_t mtvec_value = (uint64_t)trap_vector;
-    
-    // 设置直接模式（bit 0 = 0）
+    uint64_t mtvec_value = (uint64_t)trap_vector | 1;
+    uint64_t stack_top = (uint64_t)trap_stack[cpuid()] + TRAP_STACK_SIZE;
+
+    // 中断入口用 csrrw 与 mscratch 交换得到陷阱栈
+    asm volatile("csrw mscratch, %0" : : "r" (stack_top));
+
+    // 设置向量模式（bit 0 = 1）
     asm volatile("csrw mtvec, %0" : : "r" (mtvec_value));
-    printf("Trap: mtvec set to %p (direct mode)\n", (void*)mtvec_value);
+    printf("Trap: mtvec set to %p (vectored mode)\n", (void*)(mtvec_value & ~1UL));
 }
 
 void enable_interrupts(void) {
+    plic_init();
+    uart_enable_rx_interrupt();
     asm volatile("csrs mstatus, %0" : : "r" (1 << 3)); // MIE
-    asm volatile("csrs mie, %0" : : "r" (1 << 7));     // MTIE
+    asm volatile("csrs mie, %0" : : "r" ((1 << 7) | (1 << 11)));  // MTIE | MEIE
     printf("Interrupts enabled\n");
 }
 
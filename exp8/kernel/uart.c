@@ -1,10 +1,24 @@
 // kernel/uart.c
 #include "types.h"
 #include "uart.h"
+#include "console.h"
+#include "proc.h"
+#include "spinlock.h"
 #include "printf.h"
 
 #define UART_BASE 0x10000000UL
 
+// 发送：控制台输出环就是发送队列，发送空中断每次从中取最多 UART_FIFO_SIZE 字节填满 FIFO
+static struct spinlock uart_tx_lock;
+static int tx_cr_pending;          // 刚发出 '\n'，还欠一个 '\r'
+static int uart_intr_mode;         // 1 表示收发由中断驱动
+static unsigned char uart_ier;     // IER 的软件副本
+
+// 接收：中断把 FIFO 中的字节搬进接收环，读者在环空时睡眠
+static char rx_buf[UART_RX_BUF];
+static volatile uint32_t rx_r;     // 读者位置
+static volatile uint32_t rx_w;     // 中断写入位置
+
 // 从 UART 寄存器读取
 static inline unsigned char uart_read_reg(int reg) {
     volatile unsigned char *addr = (volatile unsigned char *)(UART_BASE + reg);
@@ -17,7 +31,14 @@ static inline void uart_write_reg(int reg, unsigned char val) {
     *addr = val;
 }
 
-// 输出单个字符
+static void uart_set_ier(unsigned char ier) {
+    if (ier != uart_ier) {
+        uart_ier = ier;
+        uart_write_reg(UART_IER, ier);
+    }
+}
+
+// 输出单个字符（轮询，不经过输出环）
 void uart_putc(char c) {
     while ((uart_read_reg(UART_LSR) & LSR_TX_IDLE) == 0)
         ;
@@ -39,42 +60,158 @@ void uart_puts(char *s) {
     }
 }
 
+// FIFO 已空时调用：从输出环取字节写满 FIFO（'\n' 后补 '\r'），
+// 返回 1 表示 FIFO 写满、输出环可能还有剩余；调用者持 uart_tx_lock
+static int uart_tx_fill(void) {
+    char c;
+
+    for (int n = 0; n < UART_FIFO_SIZE; n++) {
+        if (tx_cr_pending) {
+            tx_cr_pending = 0;
+            uart_write_reg(UART_THR, '\r');
+            continue;
+        }
+        if (!console_tx_getc(&c)) {
+            return 0;
+        }
+        uart_write_reg(UART_THR, c);
+        if (c == '\n') {
+            tx_cr_pending = 1;
+        }
+    }
+    return 1;
+}
+
+// 启动发送。中断模式下 FIFO 空就立即填一批，并打开发送空中断由它接着送；
+// 轮询模式（中断尚未启用）或 sync=1（输出环满、刷新）时逐批等待 FIFO 空直到送完
+void uart_tx_kick(int sync) {
+    acquire(&uart_tx_lock);
+    if (sync || !uart_intr_mode) {
+        do {
+            while ((uart_read_reg(UART_LSR) & LSR_TX_IDLE) == 0)
+                ;
+        } while (uart_tx_fill());
+    } else {
+        if (uart_read_reg(UART_LSR) & LSR_TX_IDLE) {
+            uart_tx_fill();
+        }
+        // 输出环取空时由中断处理函数关掉发送空中断
+        uart_set_ier(uart_ier | IER_TX_ENABLE);
+    }
+    release(&uart_tx_lock);
+}
+
 // 检查是否有输入可用
 int uart_input_available(void) {
     return (uart_read_reg(UART_LSR) & LSR_RX_READY) != 0;
 }
 
-// 读取字符
-char uart_getc(void) {
+// 轮询读取一个字符
+static char uart_getc_poll(void) {
     while (!uart_input_available())
         ;
     return uart_read_reg(UART_RHR);
 }
 
-// UART 初始化 - 简化版本，禁用所有中断
+// 读取至多 n 个字符，读到换行即返回；接收环为空时睡眠等待接收中断唤醒。
+// 中断尚未启用或没有进程上下文时退回轮询读一个字符
+int uart_read(char *dst, int n) {
+    int got = 0;
+
+    if (n <= 0) {
+        return 0;
+    }
+    if (!uart_intr_mode || !curr_proc) {
+        dst[0] = uart_getc_poll();
+        return 1;
+    }
+
+    // 检查接收环与挂入等待队列之间关中断，避免丢失唤醒
+    push_off();
+    while (rx_r == rx_w) {
+        if (curr_proc->killed) {
+            pop_off();
+            return -1;
+        }
+        sleep((void *)&rx_r);
+    }
+    while (got < n && rx_r != rx_w) {
+        char c = rx_buf[rx_r & (UART_RX_BUF - 1)];
+        rx_r++;
+        dst[got++] = c;
+        if (c == '\n' || c == '\r') {
+            break;
+        }
+    }
+    pop_off();
+    return got;
+}
+
+// 读取字符
+char uart_getc(void) {
+    char c;
+
+    while (uart_read(&c, 1) != 1)
+        ;
+    return c;
+}
+
+// UART 初始化：先以轮询方式工作，uart_enable_rx_interrupt 之后改为中断驱动
 void uart_init(void) {
+    initlock(&uart_tx_lock, "uart_tx");
+
     // 禁用所有UART中断
+    uart_ier = 0;
     uart_write_reg(UART_IER, 0);
     
-    // 启用FIFO
-    uart_write_reg(UART_FCR, 1);
+    // 启用并清空FIFO
+    uart_write_reg(UART_FCR, FCR_FIFO_ENABLE | FCR_FIFO_CLEAR);
     
-    printf("UART: initialized (polling mode only)\n");
+    printf("UART: initialized (polling until interrupts are enabled)\n");
 }
 
-// 空函数 - 不启用UART中断
+// 打开接收中断并切换到中断驱动的收发；需要 PLIC 已路由 UART0_IRQ
 void uart_enable_rx_interrupt(void) {
-    // 什么都不做 - 保持禁用状态
+    acquire(&uart_tx_lock);
+    uart_intr_mode = 1;
+    uart_set_ier(IER_RX_ENABLE);
+    release(&uart_tx_lock);
+    // 输出环中积压的内容交给发送空中断
+    uart_tx_kick(0);
 }
 
 void uart_disable_interrupts(void) {
-    // 已经禁用了
+    acquire(&uart_tx_lock);
+    uart_intr_mode = 0;
+    uart_set_ier(0);
+    release(&uart_tx_lock);
 }
 
 int uart_check_interrupt(void) {
-    return 0;  // 没有中断
+    return (uart_read_reg(UART_IIR) & 1) == 0;  // IIR bit0 为 0 表示有中断待处理
 }
 
+// UART 中断：接收 FIFO 全部搬入接收环并唤醒读者；发送 FIFO 空时再填一批
 void uart_interrupt_handler(void) {
-    // 空函数
-}
\ No newline at end of file
+    int got = 0;
+
+    while (uart_input_available()) {
+        char c = uart_read_reg(UART_RHR);
+        if (rx_w - rx_r < UART_RX_BUF) {  // 接收环满时丢弃
+            rx_buf[rx_w & (UART_RX_BUF - 1)] = c;
+            rx_w++;
+            got = 1;
+        }
+    }
+    if (got) {
+        wakeup((void *)&rx_r);
+    }
+
+    acquire(&uart_tx_lock);
+    if ((uart_ier & IER_TX_ENABLE) && (uart_read_reg(UART_LSR) & LSR_TX_IDLE)) {
+        if (!uart_tx_fill()) {
+            uart_set_ier(uart_ier & ~IER_TX_ENABLE);
+        }
+    }
+    release(&uart_tx_lock);
+}